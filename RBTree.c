@@ -7,181 +7,62 @@
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-#include <stdio.h>
-#include <stdlib.h>
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START ListNode STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-typedef struct List_Node {
-	struct List_Node* next;					// Next node to go to
-	void* value;							// Value of that node
-} ListNode;
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START LinkedList STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-typedef struct Linked_List {
-	int size;								// Number of nodes in the list
-	ListNode* head;							// First node on the list
-} LinkedList;
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START LinkedListIterator STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-typedef struct Linked_List_Iterator {
-	LinkedList* list;						// List to iterate on
-	ListNode* currNode;						// Current node
-	ListNode* nextNode;						// Next node to iterate to
-} LinkedListIterator;
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START RBNode STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-typedef enum RB_Node_Color {
-	UNDEFINED,
-	RED,
-	BLACK,
-} RBNodeColor;
-
-typedef struct RB_Node {
-	RBNodeColor color;					// Color of this node: RED or BLACK
-	struct RB_Node* parent;					// Parent of this node
-	struct RB_Node* children[2];			// Children of this node
-	void* key;								// The key of this node
-	void* value;							// The value of this node
-} RBNode;
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START RBTree STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-typedef int (*Comparator)(void*, void*);	// Comparison function between keys
-
-typedef struct RBTree {
-	RBNode* root;							// The root of the tree
-	Comparator keyCompareFunction;			// The comparison function for keys
-} RBTree;
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// Start RBTreeIterator STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-typedef struct RBTreeIterator {
-	RBTree* tree;							// Tree to iterate on
-	RBNode* currNode;						// Current node
-	RBNode* nextNode;						// Next node to iterate to
-} RBTreeIterator;
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START ListNode FUNCTION DECLARATIONS
-//
-////////////////////////////////////////////////////////////////////////////////
-
-ListNode* 			ListNode_create(ListNode*, void*);
-void 				ListNode_delete(ListNode*);
-ListNode*			ListNode_getNext(ListNode*);
-void* 				ListNode_getValue(ListNode*);
-void 				ListNode_setNext(ListNode*, ListNode*);
-void 				ListNode_setValue(ListNode*, void*);
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START LinkedList FUNCTION DECLARATIONS
-//
-////////////////////////////////////////////////////////////////////////////////
-
-LinkedList* 		LinkedList_create();
-void				LinkedList_delete(LinkedList*);
-int					LinkedList_add(LinkedList*, int, void*);
-void*				LinkedList_remove(LinkedList*, int);
-int 				LinkedList_isEmpty(LinkedList*);
-void*				LinkedList_get(LinkedList*, int);
-int 				LinkedList_size(LinkedList*);
-int 				LinkedList_contains(LinkedList*, void*);
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START LinkedListIterator STRUCTURES
-//
-////////////////////////////////////////////////////////////////////////////////
-
-LinkedListIterator*	LinkedListIterator_create(LinkedList*);
-void 				LinkedListIterator_delete(LinkedListIterator*);
-void*				LinkedListIterator_getValue(LinkedListIterator*);
-void 				LinkedListIterator_getNext(LinkedListIterator*);
-int 				LinkedListIterator_hasNext(LinkedListIterator*);
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START RBNode FUNCTION DECLARATIONS
-//
-////////////////////////////////////////////////////////////////////////////////
-
-RBNode* 			RBNode_create(RBNodeColor, RBNode*, RBNode*, RBNode*, void*, void*);
-void 				RBNode_delete(RBNode*);
-RBNodeColor 		RBNode_getColor(RBNode*);
-RBNode* 			RBNode_getParent(RBNode*);
-RBNode* 			RBNode_getLeftChild(RBNode*);
-RBNode* 			RBNode_getRightChild(RBNode*);
-void* 				RBNode_getKey(RBNode*);
-void* 				RBNode_getValue(RBNode*);
-void 				RBNode_setColor(RBNode*, RBNodeColor);
-void 				RBNode_setParent(RBNode*, RBNode*);
-void				RBNode_setLeftChild(RBNode*, RBNode*);
-void				RBNode_setRightChild(RBNode*, RBNode*);
-void 				RBNode_setKey(RBNode*, void*);
-void 				RBNode_setValue(RBNode*, void*);
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
 
-////////////////////////////////////////////////////////////////////////////////
-//
-// START RBTree FUNCTION DECLARATIONS
-//
-////////////////////////////////////////////////////////////////////////////////
-
-RBTree* 			RBTree_create(Comparator);
-void 				RBTree_delete(RBTree*);
-void 				RBTree_delete_recursion(RBNode*);
-RBNode* 			RBTree_getRoot(RBTree*);
-Comparator 			RBTree_getKeyCompareFunction(RBTree*);
-void 				RBTree_setRoot(RBTree*, RBNode*);
-void 				RBTree_setKeyCompareFunction(RBTree*, Comparator);
-void 				RBTree_repairAfterInsert(RBTree*, RBNode*);
-void* 				RBTree_search(RBTree*, void*);
-int 				RBTree_remove(RBTree*, void*);
-void 				RBTree_repairAfterRemove(RBTree*);
-void 				RBTree_rotateLeft(RBTree*, RBNode*);
-void 				RBTree_rotateRight(RBTree*, RBNode*);
-
-////////////////////////////////////////////////////////////////////////////////
-//
-// START RBTreeIterator FUNCTION DECLARATIONS
-//
-////////////////////////////////////////////////////////////////////////////////
+#include "RBTree.h"
 
-RBTreeIterator*		RBTreeIterator_create(RBTree*);
-void 				RBTreeIterator_delete(RBTreeIterator*);
-void* 				RBTreeIterator_getKey(RBTreeIterator*);
-void*				RBTreeIterator_getValue(RBTreeIterator*);
-void 				RBTreeIterator_getNext(RBTreeIterator*);
-int 				RBTreeIterator_hasNext(RBTreeIterator*);
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RBTREE_PREFETCH(address) __builtin_prefetch(address)
+#define RBTREE_LOAD(field) __atomic_load_n(&(field), __ATOMIC_ACQUIRE)
+#define RBTREE_STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELEASE)
+#else
+#define RBTREE_PREFETCH(address) ((void)(address))
+#define RBTREE_LOAD(field) (field)
+#define RBTREE_STORE(field, value) ((field) = (value))
+#endif
+
+#define RBTREE_SEARCH_GROUP 16				// Lookups walked in lockstep by RBTree_searchBatch
+#define RBTREE_MAX_HEIGHT 128				// Bound on tree height, at most 2 * log2(n + 1)
+#define RBTREE_OPTIMISTIC_RETRIES 8			// Lock-free attempts before a lookup falls back to the lock
+#define RBFROZENTREE_BLOCK 16				// Int keys per search block, one 64-byte cache line
+
+// Define RBTREE_NO_SIMD to use the scalar search loops even where SSE2 is available
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__)) && !defined(RBTREE_NO_SIMD)
+#include <emmintrin.h>
+#define RBTREE_SIMD 1
+#endif
+#define RBTREE_IMAGE_MAGIC "RBTIMG01"		// First eight bytes of a file written by RBTree_save
+#define RBTREE_IMAGE_HEADER 16				// Magic and entry count, followed by the offset table
+
+#ifdef RBTREE_COMPACT_NODES
+#define RBNODE_BLACK_BIT ((uintptr_t)1)
+#endif
+
+// RBTREE_COUNT adds to a tree counter and yields its previous value. Counters are relaxed atomics
+// so that Par_ readers sharing a lock can count, and vanish without RBTREE_STATS.
+#ifdef RBTREE_STATS
+#include <time.h>
+#define RBTREE_STATS_SAMPLE 64				// One comparison in this many is timed
+#if defined(__GNUC__) || defined(__clang__)
+#define RBTREE_COUNT(tree, counter, n) __atomic_fetch_add(&(tree)->counters.counter, (n), __ATOMIC_RELAXED)
+#else
+#define RBTREE_COUNT(tree, counter, n) (((tree)->counters.counter += (n)) - (n))
+#endif
+#else
+#define RBTREE_COUNT(tree, counter, n) ((void)(n))
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 //
@@ -189,13 +70,13 @@ int 				RBTreeIterator_hasNext(RBTreeIterator*);
 //
 ////////////////////////////////////////////////////////////////////////////////
 
-ListNode* ListNode_create(ListNode* next, void* value) {
+ListNode* ListNode_create(ListNode* next) {
 	ListNode* newListNode = malloc(sizeof(ListNode));
 	if (NULL == newListNode) {
 		return NULL;
 	}
 	newListNode->next = next;
-	newListNode->value = value;
+	newListNode->count = 0;
 	return newListNode;
 }
 
@@ -213,11 +94,18 @@ ListNode* ListNode_getNext(ListNode* node) {
 	return node->next;
 }
 
-void* ListNode_getValue(ListNode* node) {
+int ListNode_getCount(ListNode* node) {
 	if (NULL == node) {
+		return 0;
+	}
+	return node->count;
+}
+
+void* ListNode_getValue(ListNode* node, int index) {
+	if (NULL == node || 0 > index || index >= node->count) {
 		return NULL;
 	}
-	return node->value;
+	return node->values[index];
 }
 
 void ListNode_setNext(ListNode* node, ListNode* next) {
@@ -227,11 +115,11 @@ void ListNode_setNext(ListNode* node, ListNode* next) {
 	node->next = next;
 }
 
-void ListNode_setValue(ListNode* node, void* value) {
-	if (NULL == node) {
+void ListNode_setValue(ListNode* node, int index, void* value) {
+	if (NULL == node || 0 > index || index >= node->count) {
 		return;
 	}
-	node->value = value;
+	node->values[index] = value;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -247,6 +135,7 @@ LinkedList* LinkedList_create() {
 	}
 	newLinkedList->size = 0;
 	newLinkedList->head = NULL;
+	newLinkedList->tail = NULL;
 	return newLinkedList;
 }
 
@@ -255,15 +144,29 @@ void LinkedList_delete(LinkedList* list) {
 		return;
 	}
 	ListNode* currNode = list->head;
-	ListNode* nextNode = ListNode_getNext(currNode);
 	while (NULL != currNode) {
+		ListNode* nextNode = ListNode_getNext(currNode);
+		ListNode_delete(currNode);
 		currNode = nextNode;
-		nextNode = ListNode_getNext(currNode);
-		free(currNode);
 	}
 	free(list);
 }
 
+ListNode* LinkedList_findNode(LinkedList* list, int* index, ListNode** prevNode) {
+	// Skips whole nodes to the one holding index, which becomes the offset within it
+	ListNode* prev = NULL;
+	ListNode* currNode = list->head;
+	while (NULL != currNode && *index >= currNode->count) {
+		*index -= currNode->count;
+		prev = currNode;
+		currNode = currNode->next;
+	}
+	if (NULL != prevNode) {
+		*prevNode = prev;
+	}
+	return currNode;
+}
+
 int	LinkedList_add(LinkedList* list, int index, void* value) {
 	if (NULL == list) {
 		return 1;
@@ -273,36 +176,108 @@ int	LinkedList_add(LinkedList* list, int index, void* value) {
 		return 1;
 	}
 
-	ListNode* prevNode = NULL;
-	ListNode* currNode = list->head;
-	for (; index != 0; index--) {
-		prevNode = currNode;
-		currNode = ListNode_getNext(prevNode);
+	ListNode* currNode;
+	if (index == list->size) {
+		// Appending only ever touches the tail
+		currNode = list->tail;
+		index = ListNode_getCount(currNode);
+		if (NULL == currNode || LISTNODE_CAPACITY == currNode->count) {
+			ListNode* newNode = ListNode_create(NULL);
+			if (NULL == newNode) {
+				return 1;
+			}
+			if (NULL == currNode) {
+				list->head = newNode;
+			} else {
+				currNode->next = newNode;
+			}
+			list->tail = newNode;
+			currNode = newNode;
+			index = 0;
+		}
+	} else {
+		currNode = LinkedList_findNode(list, &index, NULL);
+		if (LISTNODE_CAPACITY == currNode->count) {
+			// Split the full node, moving its upper half into a new node after it
+			ListNode* newNode = ListNode_create(currNode->next);
+			if (NULL == newNode) {
+				return 1;
+			}
+			int half = LISTNODE_CAPACITY / 2;
+			newNode->count = LISTNODE_CAPACITY - half;
+			memcpy(newNode->values, currNode->values + half, (size_t)newNode->count * sizeof(void*));
+			currNode->count = half;
+			currNode->next = newNode;
+			if (list->tail == currNode) {
+				list->tail = newNode;
+			}
+			if (index > half) {
+				currNode = newNode;
+				index -= half;
+			}
+		}
+		memmove(currNode->values + index + 1, currNode->values + index, (size_t)(currNode->count - index) * sizeof(void*));
 	}
-
-	ListNode* newNode = ListNode_create(currNode, value);
-	if (NULL != prevNode) {
-		ListNode_setNext(prevNode, newNode);
-	}	
-
+	currNode->values[index] = value;
+	currNode->count++;
+	list->size++;
 	return 0;
 }
 
+int LinkedList_append(LinkedList* list, void* value) {
+	return LinkedList_add(list, LinkedList_size(list), value);
+}
+
 void* LinkedList_remove(LinkedList* list, int index) {
-	// TODO: Implement this later
-	return NULL;
+	if (NULL == list || 0 > index || index >= list->size) {
+		return NULL;
+	}
+	ListNode* prevNode;
+	ListNode* currNode = LinkedList_findNode(list, &index, &prevNode);
+	void* value = currNode->values[index];
+	currNode->count--;
+	memmove(currNode->values + index, currNode->values + index + 1, (size_t)(currNode->count - index) * sizeof(void*));
+	list->size--;
+
+	ListNode* nextNode = currNode->next;
+	if (0 == currNode->count) {
+		// Unlink the emptied node
+		if (NULL == prevNode) {
+			list->head = nextNode;
+		} else {
+			prevNode->next = nextNode;
+		}
+		if (list->tail == currNode) {
+			list->tail = prevNode;
+		}
+		ListNode_delete(currNode);
+	} else if (NULL != nextNode && LISTNODE_CAPACITY / 2 > currNode->count
+		&& LISTNODE_CAPACITY >= currNode->count + nextNode->count) {
+		// Fold the next node into a node that fell below half full
+		memcpy(currNode->values + currNode->count, nextNode->values, (size_t)nextNode->count * sizeof(void*));
+		currNode->count += nextNode->count;
+		currNode->next = nextNode->next;
+		if (list->tail == nextNode) {
+			list->tail = currNode;
+		}
+		ListNode_delete(nextNode);
+	}
+	return value;
 }
 
 int LinkedList_isEmpty(LinkedList* list) {
 	if (NULL == list) {
 		return 1;
 	}
-	return (0 > list->size) ? 1 : 0;
+	return (0 == list->size) ? 1 : 0;
 }
 
 void* LinkedList_get(LinkedList* list, int index) {
-	// TODO: Implement this later
-	return NULL;
+	if (NULL == list || 0 > index || index >= list->size) {
+		return NULL;
+	}
+	ListNode* currNode = LinkedList_findNode(list, &index, NULL);
+	return currNode->values[index];
 }
 
 int LinkedList_size(LinkedList* list) {
@@ -313,8 +288,17 @@ int LinkedList_size(LinkedList* list) {
 }
 
 int LinkedList_contains(LinkedList* list, void* value) {
-	// TODO: Implement this later
-	return 1;
+	if (NULL == list) {
+		return 0;
+	}
+	for (ListNode* currNode = list->head; NULL != currNode; currNode = currNode->next) {
+		for (int i = 0; i < currNode->count; i++) {
+			if (value == currNode->values[i]) {
+				return 1;
+			}
+		}
+	}
+	return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -328,10 +312,19 @@ LinkedListIterator*	LinkedListIterator_create(LinkedList* list) {
 	if (NULL == newIter) {
 		return NULL;
 	}
-	newIter->list = list;
-	newIter->currNode = NULL;
-	newIter->nextNode = LinkedList_get(list, 0);
-	return NULL;
+	LinkedListIterator_init(newIter, list);
+	return newIter;
+}
+
+void LinkedListIterator_init(LinkedListIterator* iter, LinkedList* list) {
+	if (NULL == iter) {
+		return;
+	}
+	iter->list = list;
+	iter->currNode = NULL;
+	iter->currIndex = 0;
+	iter->nextNode = (NULL == list) ? NULL : list->head;
+	iter->nextIndex = 0;
 }
 
 void LinkedListIterator_delete(LinkedListIterator* iter) {
@@ -345,20 +338,24 @@ void* LinkedListIterator_getValue(LinkedListIterator* iter) {
 	if (NULL == iter) {
 		return NULL;
 	}
-	return ListNode_getValue(iter->currNode);
+	return ListNode_getValue(iter->currNode, iter->currIndex);
 }
 
 void LinkedListIterator_getNext(LinkedListIterator* iter) {
 	if (NULL == iter) {
 		return;
 	}
-	if (NULL == iter->currNode) {
-		iter->nextNode = NULL;
+	iter->currNode = iter->nextNode;
+	iter->currIndex = iter->nextIndex;
+	if (NULL == iter->nextNode) {
 		return;
 	}
-	iter->currNode = iter->nextNode;
-	iter->nextNode = ListNode_getNext(iter->currNode);
-	return;
+	// Step within the node, then on to the start of the next one
+	iter->nextIndex++;
+	if (iter->nextIndex >= iter->nextNode->count) {
+		iter->nextNode = iter->nextNode->next;
+		iter->nextIndex = 0;
+	}
 }
 
 int LinkedListIterator_hasNext(LinkedListIterator* iter) {
@@ -379,8 +376,10 @@ RBNode* RBNode_create(RBNodeColor color, RBNode* parent, RBNode* left, RBNode* r
   if (NULL == newNode) {
   	return NULL;
   }
-  newNode->color = color;
-  newNode->parent = parent;
+  newNode->parent = NULL;
+  RBNode_setColor(newNode, color);
+  RBNode_setParent(newNode, parent);
+  RBNode_setSize(newNode, 1);
   newNode->children[0] = left;
   newNode->children[1] = right;
   newNode->key = key;
@@ -398,14 +397,22 @@ RBNodeColor RBNode_getColor(RBNode* node) {
 	if (NULL == node) {
 		return UNDEFINED;
 	}
+#ifdef RBTREE_COMPACT_NODES
+	return ((uintptr_t)node->parent & RBNODE_BLACK_BIT) ? BLACK : RED;
+#else
 	return node->color; 
+#endif
 }
 
 RBNode* RBNode_getParent(RBNode* node) {
 	if (NULL == node) {
 		return NULL;
 	}
+#ifdef RBTREE_COMPACT_NODES
+	return (RBNode*)((uintptr_t)node->parent & ~RBNODE_BLACK_BIT);
+#else
 	return node->parent; 
+#endif
 }
 
 RBNode* RBNode_getLeftChild(RBNode* node) {
@@ -422,6 +429,17 @@ RBNode* RBNode_getRightChild(RBNode* node) {
 	return node->children[1]; 
 }
 
+int RBNode_getSize(RBNode* node) {
+	if (NULL == node) {
+		return 0;
+	}
+#ifdef RBTREE_COMPACT_NODES
+	return 0;
+#else
+	return node->size;
+#endif
+}
+
 void* RBNode_getKey(RBNode* node) {
 	if (NULL == node) {
 		return NULL;
@@ -436,46 +454,212 @@ void* RBNode_getValue(RBNode* node) {
 	return node->value;
 }
 
+RBNode* RBNode_getSuccessor(RBNode* node) {
+	// The next node in key order, found through parent links
+	if (NULL == node) {
+		return NULL;
+	}
+	if (NULL != RBNode_getRightChild(node)) {
+		node = RBNode_getRightChild(node);
+		while (NULL != RBNode_getLeftChild(node)) {
+			node = RBNode_getLeftChild(node);
+		}
+		return node;
+	}
+	RBNode* parent = RBNode_getParent(node);
+	while (NULL != parent && node == RBNode_getRightChild(parent)) {
+		node = parent;
+		parent = RBNode_getParent(node);
+	}
+	return parent;
+}
+
 void RBNode_setColor(RBNode* node, RBNodeColor color) {
 	if (NULL == node) {
 		return;
 	}
+#ifdef RBTREE_COMPACT_NODES
+	uintptr_t parent = (uintptr_t)node->parent & ~RBNODE_BLACK_BIT;
+	node->parent = (RBNode*)(parent | ((BLACK == color) ? RBNODE_BLACK_BIT : 0));
+#else
 	node->color = color;
+#endif
 }
 
 void RBNode_setParent(RBNode* node, RBNode* parent) {
 	if (NULL == node) {
 		return;
 	}
+#ifdef RBTREE_COMPACT_NODES
+	node->parent = (RBNode*)((uintptr_t)parent | ((uintptr_t)node->parent & RBNODE_BLACK_BIT));
+#else
 	node->parent = parent;
+#endif
+}
+
+void RBNode_setSize(RBNode* node, int size) {
+	if (NULL == node) {
+		return;
+	}
+#ifdef RBTREE_COMPACT_NODES
+	(void)size;
+#else
+	node->size = size;
+#endif
 }
 
 void RBNode_setLeftChild(RBNode* node, RBNode* child) {
 	if (NULL == node) {
 		return;
 	}
-	node->children[0] = child;
+	RBTREE_STORE(node->children[0], child);
 }
 
 void RBNode_setRightChild(RBNode* node, RBNode* child) {
 	if (NULL == node) {
 		return;
 	}
-	node->children[1] = child;
+	RBTREE_STORE(node->children[1], child);
 }
 
 void RBNode_setKey(RBNode* node, void* key) {
 	if (NULL == node) {
 		return;
 	}
-	node->key = key;
+	RBTREE_STORE(node->key, key);
 }
 
 void RBNode_setValue(RBNode* node, void* value) {
 	if (NULL == node) {
 		return;
 	}
-	node->value = value;
+	RBTREE_STORE(node->value, value);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBNodeArena FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBNodeArena* RBNodeArena_create(int nodesPerSlab) {
+	RBNodeArena* newArena = malloc(sizeof(RBNodeArena));
+	if (NULL == newArena) {
+		return NULL;
+	}
+	newArena->slabs = NULL;
+	newArena->nodesPerSlab = (0 < nodesPerSlab) ? nodesPerSlab : RBNODEARENA_DEFAULT_SLAB;
+	newArena->nextNode = 0;
+	newArena->freeNodes = NULL;
+	newArena->refCount = 1;
+	newArena->mergedInto = NULL;
+	return newArena;
+}
+
+void RBNodeArena_delete(RBNodeArena* arena) {
+	if (NULL == arena) {
+		return;
+	}
+	// Trees split from one another share the arena, the last one frees it
+	if (0 < --arena->refCount) {
+		return;
+	}
+	// Every node lives in a slab, so dropping the slabs frees the whole tree
+	RBNodeSlab* currSlab = arena->slabs;
+	while (NULL != currSlab) {
+		RBNodeSlab* nextSlab = currSlab->next;
+		free(currSlab);
+		currSlab = nextSlab;
+	}
+	// A merged arena has no slabs left, it only kept the one that took them alive
+	RBNodeArena_delete(arena->mergedInto);
+	free(arena);
+}
+
+RBNodeArena* RBNodeArena_retain(RBNodeArena* arena) {
+	if (NULL != arena) {
+		arena->refCount++;
+	}
+	return arena;
+}
+
+int RBNodeArena_adopt(RBNodeArena* arena, RBNodeArena* other) {
+	// Moves the slabs of other into arena, so nodes from both can share a tree. Ownership stays flat:
+	// other keeps only a reference to arena, and arena none to other, so no two arenas can hold each other.
+	arena = RBNodeArena_find(arena);
+	other = RBNodeArena_find(other);
+	if (NULL == arena || NULL == other) {
+		return 1;
+	}
+	if (arena == other) {
+		return 0;
+	}
+	if (NULL == arena->slabs) {
+		arena->slabs = other->slabs;
+		arena->nextNode = other->nextNode;
+	} else if (NULL != other->slabs) {
+		// Behind the newest slab, whose unused nodes arena still carves; those of other's newest slab go unused
+		RBNodeSlab* lastSlab = other->slabs;
+		while (NULL != lastSlab->next) {
+			lastSlab = lastSlab->next;
+		}
+		lastSlab->next = arena->slabs->next;
+		arena->slabs->next = other->slabs;
+	}
+	if (NULL != other->freeNodes) {
+		RBNode* lastNode = other->freeNodes;
+		while (NULL != lastNode->parent) {
+			lastNode = lastNode->parent;
+		}
+		lastNode->parent = arena->freeNodes;
+		arena->freeNodes = other->freeNodes;
+	}
+	other->slabs = NULL;
+	other->freeNodes = NULL;
+	other->mergedInto = RBNodeArena_retain(arena);
+	return 0;
+}
+
+RBNodeArena* RBNodeArena_find(RBNodeArena* arena) {
+	// The arena that now owns the slabs of arena, following merges
+	while (NULL != arena && NULL != arena->mergedInto) {
+		arena = arena->mergedInto;
+	}
+	return arena;
+}
+
+RBNode* RBNodeArena_alloc(RBNodeArena* arena) {
+	arena = RBNodeArena_find(arena);
+	if (NULL == arena) {
+		return NULL;
+	}
+	// Reuse a released node before carving a new one
+	if (NULL != arena->freeNodes) {
+		RBNode* node = arena->freeNodes;
+		arena->freeNodes = node->parent;
+		return node;
+	}
+	// Start a new slab once the newest one is used up
+	if (NULL == arena->slabs || arena->nextNode == arena->slabs->capacity) {
+		RBNodeSlab* newSlab = malloc(sizeof(RBNodeSlab) + (size_t)arena->nodesPerSlab * sizeof(RBNode));
+		if (NULL == newSlab) {
+			return NULL;
+		}
+		newSlab->next = arena->slabs;
+		newSlab->capacity = arena->nodesPerSlab;
+		arena->slabs = newSlab;
+		arena->nextNode = 0;
+	}
+	return &arena->slabs->nodes[arena->nextNode++];
+}
+
+void RBNodeArena_free(RBNodeArena* arena, RBNode* node) {
+	arena = RBNodeArena_find(arena);
+	if (NULL == arena || NULL == node) {
+		return;
+	}
+	node->parent = arena->freeNodes;
+	arena->freeNodes = node;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -486,34 +670,158 @@ void RBNode_setValue(RBNode* node, void* value) {
 
 RBTree* RBTree_create(Comparator keyCompareFunction) {
 	RBTree* newTree = malloc(sizeof(RBTree));
+	if (NULL == newTree) {
+		return NULL;
+	}
 	newTree->root = NULL;
 	newTree->keyCompareFunction = keyCompareFunction;
+	newTree->arena = NULL;
+	newTree->freeNodes = NULL;
+	newTree->size = 0;
+	atomic_init(&newTree->sequence, 0);
+	newTree->augmented = 0;
+	newTree->multimap = 0;
+	newTree->keyDestructor = NULL;
+	newTree->valueDestructor = NULL;
+	RBTree_resetStats(newTree);
+	if (0 != pthread_rwlock_init(&newTree->lock, NULL)) {
+		free(newTree);
+		return NULL;
+	}
+	return newTree;
+}
+
+RBTree* RBTree_createWithArena(Comparator keyCompareFunction, int nodesPerSlab) {
+	RBTree* newTree = RBTree_create(keyCompareFunction);
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->arena = RBNodeArena_create(nodesPerSlab);
+	if (NULL == newTree->arena) {
+		RBTree_delete(newTree);
+		return NULL;
+	}
+	return newTree;
+}
+
+RBTree* RBTree_buildFromSorted(void** keys, void** values, int n, Comparator keyCompareFunction) {
+	if (NULL == keys || NULL == values || 0 > n) {
+		return NULL;
+	}
+	// Keys must already be in tree order
+	for (int i = 1; i < n; i++) {
+		if (0 > keyCompareFunction(keys[i - 1], keys[i])) {
+			return NULL;
+		}
+	}
+	// Size the first slab so every node comes from a single allocation
+	RBTree* newTree = RBTree_createWithArena(keyCompareFunction, n);
+	if (NULL == newTree) {
+		return NULL;
+	}
+	// Carve the slab up front so the build itself cannot run out of nodes
+	if (0 < n) {
+		RBNode* firstNode = RBNodeArena_alloc(newTree->arena);
+		if (NULL == firstNode) {
+			RBTree_delete(newTree);
+			return NULL;
+		}
+		RBNodeArena_free(newTree->arena, firstNode);
+	}
+	// Only the deepest level can be partially filled, colour it red
+	int redDepth = 0;
+	while ((2 << redDepth) <= n) {
+		redDepth++;
+	}
+	newTree->root = RBTree_buildFromSorted_recursion(newTree, NULL, keys, values, 0, n, 0, redDepth);
+	newTree->size = n;
+	RBNode_setColor(newTree->root, BLACK);
+	return newTree;
+}
+
+RBNode* RBTree_buildFromSorted_recursion(RBTree* tree, RBNode* parent, void** keys, void** values, int lo, int hi, int depth, int redDepth) {
+	if (lo >= hi) {
+		return NULL;
+	}
+	int mid = lo + (hi - lo) / 2;
+	RBNode* node = RBTree_createNode(tree, (depth == redDepth) ? RED : BLACK, parent, NULL, NULL, keys[mid], values[mid]);
+	// Halves differ by at most one node, so every level above the last is full
+	node->children[0] = RBTree_buildFromSorted_recursion(tree, node, keys, values, lo, mid, depth + 1, redDepth);
+	node->children[1] = RBTree_buildFromSorted_recursion(tree, node, keys, values, mid + 1, hi, depth + 1, redDepth);
+	RBNode_setSize(node, hi - lo);
+	return node;
+}
+
+RBTree* RBTree_createWithDestructors(Comparator keyCompareFunction, Destructor keyDestructor, Destructor valueDestructor) {
+	RBTree* newTree = RBTree_create(keyCompareFunction);
+	RBTree_setDestructors(newTree, keyDestructor, valueDestructor);
 	return newTree;
 }
 
+void RBTree_setDestructors(RBTree* tree, Destructor keyDestructor, Destructor valueDestructor) {
+	if (NULL == tree) {
+		return;
+	}
+	tree->keyDestructor = keyDestructor;
+	tree->valueDestructor = valueDestructor;
+}
+
 void RBTree_delete(RBTree* tree) {
 	if (NULL != tree) {
-	// Recurse down the tree, deleting
-		RBTree_delete_recursion(tree->root);
+		if (NULL != tree->arena) {
+			if (NULL != tree->keyDestructor || NULL != tree->valueDestructor || tree->multimap) {
+				RBTree_deleteNodes(tree, tree->root);
+			}
+			// All nodes belong to the arena, drop them in one step
+			RBNodeArena_delete(tree->arena);
+		} else {
+			RBTree_deleteNodes(tree, tree->root);
+			while (NULL != tree->freeNodes) {
+				RBNode* nextNode = tree->freeNodes->parent;
+				RBNode_delete(tree->freeNodes);
+				tree->freeNodes = nextNode;
+			}
+		}
+		pthread_rwlock_destroy(&tree->lock);
 		free(tree);
 	}
 }
 
-void RBTree_delete_recursion(RBNode* node) {
-	if (NULL == node) {
-		return;
+void RBTree_deleteNodes(RBTree* tree, RBNode* node) {
+	// Rotates left children up until there are none, so every node is visited once without a stack
+	while (NULL != node) {
+		RBNode* leftChild = node->children[0];
+		if (NULL != leftChild) {
+			node->children[0] = leftChild->children[1];
+			leftChild->children[1] = node;
+			node = leftChild;
+			continue;
+		}
+		RBNode* nextNode = node->children[1];
+		RBTree_destroyEntry(tree, node);
+		if (NULL == tree->arena) {
+			RBNode_delete(node);
+		}
+		node = nextNode;
+	}
+}
+
+void RBTree_destroyEntry(RBTree* tree, RBNode* node) {
+	if (NULL != tree->keyDestructor) {
+		tree->keyDestructor(node->key);
+	}
+	if (tree->multimap) {
+		// The node owns its value group, the values in it belong to the destructor
+		LinkedListIterator iter;
+		LinkedListIterator_init(&iter, node->value);
+		while (NULL != tree->valueDestructor && LinkedListIterator_hasNext(&iter)) {
+			LinkedListIterator_getNext(&iter);
+			tree->valueDestructor(LinkedListIterator_getValue(&iter));
+		}
+		LinkedList_delete(node->value);
+	} else if (NULL != tree->valueDestructor) {
+		tree->valueDestructor(node->value);
 	}
-	// Delete the left subtree
-    if (NULL != RBNode_getLeftChild(node)) {
-    	RBTree_delete_recursion(RBNode_getLeftChild(node));
-    }
-    // Delete the right subtree
-    if (NULL != RBNode_getRightChild(node)) {
-    	RBTree_delete_recursion(RBNode_getRightChild(node));
-    }
-    // Delete the current node
-    RBNode_delete(node);
-    return;
 }
 
 RBNode* RBTree_getRoot(RBTree* tree) {
@@ -534,7 +842,7 @@ void RBTree_setRoot(RBTree* tree, RBNode* root) {
 	if (NULL == tree) {
 		return;
 	}
-	tree->root = root; 
+	RBTREE_STORE(tree->root, root);
 }
 
 void RBTree_setKeyCompareFunction(RBTree* tree, Comparator keyCompareFunction) {
@@ -544,25 +852,219 @@ void RBTree_setKeyCompareFunction(RBTree* tree, Comparator keyCompareFunction) {
 	tree->keyCompareFunction = keyCompareFunction; 
 }
 
-int RBTree_compareKeys(RBTree* tree, void* key1, void* key2) {
+RBNode* RBTree_createNode(RBTree* tree, RBNodeColor color, RBNode* parent, RBNode* left, RBNode* right, void* key, void* value) {
 	if (NULL == tree) {
-		return 0;
+		return NULL;
 	}
-	return tree->keyCompareFunction(key1, key2);
+	RBNode* newNode;
+	if (NULL != tree->arena) {
+		newNode = RBNodeArena_alloc(tree->arena);
+	} else if (NULL != tree->freeNodes) {
+		// Reuse a removed node instead of going back to malloc
+		newNode = tree->freeNodes;
+		tree->freeNodes = newNode->parent;
+	} else {
+		return RBNode_create(color, parent, left, right, key, value);
+	}
+	if (NULL == newNode) {
+		return NULL;
+	}
+	newNode->parent = NULL;
+	RBNode_setColor(newNode, color);
+	RBNode_setParent(newNode, parent);
+	RBNode_setSize(newNode, 1);
+	// A reused node may still be read by a stale optimistic lookup
+	RBNode_setLeftChild(newNode, left);
+	RBNode_setRightChild(newNode, right);
+	RBNode_setKey(newNode, key);
+	RBNode_setValue(newNode, value);
+	return newNode;
 }
 
-int RBTree_insert(RBTree* tree, void* key, void* value) {
+void RBTree_deleteNode(RBTree* tree, RBNode* node) {
+	if (NULL == tree || NULL == node) {
+		return;
+	}
+	if (NULL == tree->arena) {
+		node->parent = tree->freeNodes;
+		tree->freeNodes = node;
+	} else {
+		RBNodeArena_free(tree->arena, node);
+	}
+}
+
+int RBTree_setAugmented(RBTree* tree, int augmented) {
+	// Subtree sizes are only tracked from the first insert on
+	if (NULL == tree || NULL != tree->root) {
+		return 1;
+	}
+#ifdef RBTREE_COMPACT_NODES
+	// Compact nodes have no room for subtree sizes
+	if (augmented) {
+		return 1;
+	}
+#endif
+	tree->augmented = augmented ? 1 : 0;
+	return 0;
+}
+
+int RBTree_isAugmented(RBTree* tree) {
+	if (NULL == tree) {
+		return 0;
+	}
+	return tree->augmented;
+}
+
+int RBTree_setMultimap(RBTree* tree, int multimap) {
+	// Values change from plain pointers to lists, so only an empty tree may switch
+	if (NULL == tree || NULL != tree->root) {
+		return 1;
+	}
+	tree->multimap = multimap ? 1 : 0;
+	return 0;
+}
+
+int RBTree_isMultimap(RBTree* tree) {
+	if (NULL == tree) {
+		return 0;
+	}
+	return tree->multimap;
+}
+
+int RBTree_size(RBTree* tree) {
+	if (NULL == tree) {
+		return 0;
+	}
+	return tree->size;
+}
+
+int RBTree_rank(RBTree* tree, void* key) {
+	if (NULL == tree || NULL == key || !tree->augmented) {
+		return -1;
+	}
+	// Count the keys that sort strictly before the given key
+	int rank = 0;
+	RBNode* currNode = RBTree_getRoot(tree);
+	while (NULL != currNode) {
+		if (0 < RBTree_compareKeys(tree, RBNode_getKey(currNode), key)) {
+			rank += RBNode_getSize(RBNode_getLeftChild(currNode)) + 1;
+			currNode = RBNode_getRightChild(currNode);
+		} else {
+			currNode = RBNode_getLeftChild(currNode);
+		}
+	}
+	return rank;
+}
+
+void* RBTree_select(RBTree* tree, int index) {
+	return RBNode_getKey(RBTree_selectNode(tree, index));
+}
+
+RBNode* RBTree_selectNode(RBTree* tree, int index) {
+	if (NULL == tree || !tree->augmented || 0 > index || index >= RBNode_getSize(tree->root)) {
+		return NULL;
+	}
+	RBNode* currNode = RBTree_getRoot(tree);
+	while (NULL != currNode) {
+		int leftSize = RBNode_getSize(RBNode_getLeftChild(currNode));
+		if (index < leftSize) {
+			currNode = RBNode_getLeftChild(currNode);
+		} else if (index == leftSize) {
+			return currNode;
+		} else {
+			index -= leftSize + 1;
+			currNode = RBNode_getRightChild(currNode);
+		}
+	}
+	return NULL;
+}
+
+RBNode* RBTree_lowerBound(RBTree* tree, void* key) {
+	if (NULL == tree || NULL == key) {
+		return NULL;
+	}
+	// Find the first node whose key is not less than the given key
+	RBNode* bound = NULL;
+	RBNode* currNode = RBTree_getRoot(tree);
+	while (NULL != currNode) {
+		if (0 >= RBTree_compareKeys(tree, RBNode_getKey(currNode), key)) {
+			bound = currNode;
+			currNode = RBNode_getLeftChild(currNode);
+		} else {
+			currNode = RBNode_getRightChild(currNode);
+		}
+	}
+	return bound;
+}
+
+RBNode* RBTree_upperBound(RBTree* tree, void* key) {
+	if (NULL == tree || NULL == key) {
+		return NULL;
+	}
+	// Find the first node whose key is greater than the given key
+	RBNode* bound = NULL;
+	RBNode* currNode = RBTree_getRoot(tree);
+	while (NULL != currNode) {
+		if (0 > RBTree_compareKeys(tree, RBNode_getKey(currNode), key)) {
+			bound = currNode;
+			currNode = RBNode_getLeftChild(currNode);
+		} else {
+			currNode = RBNode_getRightChild(currNode);
+		}
+	}
+	return bound;
+}
+
+void RBTree_updateSizesUpward(RBTree* tree, RBNode* node, int delta) {
+	if (NULL == tree || !tree->augmented) {
+		return;
+	}
+	for (RBNode* currNode = RBNode_getParent(node); NULL != currNode; currNode = RBNode_getParent(currNode)) {
+		RBNode_setSize(currNode, RBNode_getSize(currNode) + delta);
+	}
+}
+
+int RBTree_compareKeys(RBTree* tree, void* key1, void* key2) {
+	if (NULL == tree) {
+		return 0;
+	}
+#ifdef RBTREE_STATS
+	if (0 == RBTREE_COUNT(tree, comparisons, 1) % RBTREE_STATS_SAMPLE) {
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		int order = tree->keyCompareFunction(key1, key2);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		RBTREE_COUNT(tree, timedComparisons, 1);
+		RBTREE_COUNT(tree, comparisonNanoseconds,
+			(unsigned long)((end.tv_sec - start.tv_sec) * 1000000000L + (end.tv_nsec - start.tv_nsec)));
+		return order;
+	}
+#endif
+	return tree->keyCompareFunction(key1, key2);
+}
+
+int RBTree_insert(RBTree* tree, void* key, void* value) {
 	if (NULL == tree || NULL == key || NULL == value) {
 		return 1;
 	}
+	if (tree->multimap) {
+		return (1 == RBTree_append(tree, key, value)) ? 1 : 0;
+	}
+	return (NULL == RBTree_insertFrom(tree, NULL, key, value)) ? 1 : 0;
+}
+
+RBNode* RBTree_insertFrom(RBTree* tree, RBNode* start, void* key, void* value) {
+	// Inserts below start, which must be an ancestor of the key's insertion point, or below the root when NULL
 	RBNode* currTreeParent = NULL;
-    RBNode* currTreeNode = RBTree_getRoot(tree);
+    RBNode* currTreeNode = (NULL == start) ? RBTree_getRoot(tree) : start;
+    int goLeft = 0;
     // Find the insertion point of the key
     while (NULL != currTreeNode) {
     	// New parent is the current node
     	currTreeParent = currTreeNode;
     	// If the key is less than the current parent's key
-    	if (RBTree_compareKeys(tree, RBNode_getKey(currTreeNode), key) < 0) {
+    	goLeft = RBTree_compareKeys(tree, RBNode_getKey(currTreeNode), key) < 0;
+    	if (goLeft) {
     		// Current node is the parent's left child
     		currTreeNode = RBNode_getLeftChild(currTreeNode);
     	} else {
@@ -570,61 +1072,175 @@ int RBTree_insert(RBTree* tree, void* key, void* value) {
     		currTreeNode = RBNode_getRightChild(currTreeNode);
     	}
     }
-    RBNode* newNode;
-    if (NULL == currTreeParent) {
+    return RBTree_attachNode(tree, currTreeParent, goLeft, key, value);
+}
+
+RBNode* RBTree_attachNode(RBTree* tree, RBNode* parent, int goLeft, void* key, void* value) {
+    RBNode* newNode = RBTree_createNode(tree, RED, parent, NULL, NULL, key, value);
+    if (NULL == newNode) {
+    	return NULL;
+    }
+    if (NULL == parent) {
     	// New node is the root.
-    	newNode = RBNode_create(RED, NULL, NULL, NULL, key, value);
     	RBTree_setRoot(tree, newNode);
-    } else if (RBTree_compareKeys(tree, RBNode_getKey(currTreeParent), key) < 0) {
-    	// New node is the left child of the current parent node
-    	newNode = RBNode_create(RED, currTreeParent, NULL, NULL, key, value);
-    	RBNode_setLeftChild(currTreeParent, newNode);
+    } else if (goLeft) {
+    	// New node is the left child of the parent node
+    	RBNode_setLeftChild(parent, newNode);
     } else {
-    	// New node is the right child of the current parent node
-    	newNode = RBNode_create(RED, currTreeParent, NULL, NULL, key, value);
-    	RBNode_setRightChild(currTreeParent, newNode);
+    	// New node is the right child of the parent node
+    	RBNode_setRightChild(parent, newNode);
     }
+    tree->size++;
+    RBTree_updateSizesUpward(tree, newNode, 1);
     // Restructure tree to keep the tree sorted
     RBTree_repairAfterInsert(tree, newNode);
-    return 0;
+    return newNode;
 }
 
-int Par_RBTree_insert(RBTree* tree, void* key, void* value) {
-	if (NULL == tree || NULL == key || NULL == value) {
+int RBTree_upsert(RBTree* tree, void* key, void* value, Combiner combineFunction) {
+	// Returns 0 after inserting, 2 after combining into an existing key (key is then not kept), 1 on failure
+	if (NULL == tree || NULL == key || NULL == value || tree->multimap) {
 		return 1;
 	}
 	RBNode* currTreeParent = NULL;
-    RBNode* currTreeNode = RBTree_getRoot(tree);
-    // Find the insertion point of the key
-    while (NULL != currTreeNode) {
-    	// New parent is the current node
-    	currTreeParent = currTreeNode;
-    	// If the key is less than the current parent's key
-    	if (RBTree_compareKeys(tree, RBNode_getKey(currTreeNode), key) < 0) {
-    		// Current node is the parent's left child
-    		currTreeNode = RBNode_getLeftChild(currTreeNode);
-    	} else {
-    		// Current node is the parent's right child
-    		currTreeNode = RBNode_getRightChild(currTreeNode);
-    	}
-    }
-    RBNode* newNode;
-    if (NULL == currTreeParent) {
-    	// New node is the root.
-    	newNode = RBNode_create(RED, NULL, NULL, NULL, key, value);
-    	RBTree_setRoot(tree, newNode);
-    } else if (RBTree_compareKeys(tree, RBNode_getKey(currTreeParent), key) < 0) {
-    	// New node is the left child of the current parent node
-    	newNode = RBNode_create(RED, currTreeParent, NULL, NULL, key, value);
-    	RBNode_setLeftChild(currTreeParent, newNode);
-    } else {
-    	// New node is the right child of the current parent node
-    	newNode = RBNode_create(RED, currTreeParent, NULL, NULL, key, value);
-    	RBNode_setRightChild(currTreeParent, newNode);
-    }
-    // Restructure tree to keep the tree sorted
-    RBTree_repairAfterInsert(tree, newNode);
-    return 0;
+	RBNode* currTreeNode = RBTree_getRoot(tree);
+	int order = 0;
+	while (NULL != currTreeNode) {
+		currTreeParent = currTreeNode;
+		order = RBTree_compareKeys(tree, RBNode_getKey(currTreeNode), key);
+		if (0 == order) {
+			// Found the key, fold the new value into it without restructuring
+			RBNode_setValue(currTreeNode, (NULL == combineFunction) ? value : combineFunction(currTreeNode->value, value));
+			return 2;
+		}
+		currTreeNode = (0 > order) ? RBNode_getLeftChild(currTreeNode) : RBNode_getRightChild(currTreeNode);
+	}
+	return (NULL == RBTree_attachNode(tree, currTreeParent, 0 > order, key, value)) ? 1 : 0;
+}
+
+int RBTree_append(RBTree* tree, void* key, void* value) {
+	// Returns 0 after starting a group, 2 after joining an existing one (key is then not kept), 1 on failure
+	if (NULL == tree || NULL == key || NULL == value || !tree->multimap) {
+		return 1;
+	}
+	RBNode* currTreeParent = NULL;
+	RBNode* currTreeNode = RBTree_getRoot(tree);
+	int order = 0;
+	while (NULL != currTreeNode) {
+		currTreeParent = currTreeNode;
+		order = RBTree_compareKeys(tree, RBNode_getKey(currTreeNode), key);
+		if (0 == order) {
+			return (0 == LinkedList_append(RBNode_getValue(currTreeNode), value)) ? 2 : 1;
+		}
+		currTreeNode = (0 > order) ? RBNode_getLeftChild(currTreeNode) : RBNode_getRightChild(currTreeNode);
+	}
+	LinkedList* group = LinkedList_create();
+	if (NULL == group || 0 != LinkedList_append(group, value)) {
+		LinkedList_delete(group);
+		return 1;
+	}
+	if (NULL == RBTree_attachNode(tree, currTreeParent, 0 > order, key, group)) {
+		LinkedList_delete(group);
+		return 1;
+	}
+	return 0;
+}
+
+int RBTree_insertBatch(RBTree* tree, void** keys, void** values, int n) {
+	if (NULL == tree || NULL == keys || NULL == values || 0 > n || tree->multimap) {
+		return 1;
+	}
+	RBTreeEntry* entries = malloc(2 * (size_t)n * sizeof(RBTreeEntry) + 1);
+	if (NULL == entries) {
+		return 1;
+	}
+	for (int i = 0; i < n; i++) {
+		if (NULL == keys[i] || NULL == values[i]) {
+			free(entries);
+			return 1;
+		}
+		entries[i].key = keys[i];
+		entries[i].value = values[i];
+	}
+	// With n nodes set aside, no insert below can fail and leave the batch half applied
+	if (0 != RBTree_reserveNodes(tree, n)) {
+		free(entries);
+		return 1;
+	}
+	// Stable, so equal keys land in batch order just as with repeated RBTree_insert
+	RBTree_sortEntries(tree, entries, entries + n, n);
+
+	RBNode* lastNode = NULL;
+	for (int i = 0; i < n; i++) {
+		// Climb from the previous insertion to the lowest subtree whose key range holds this key
+		RBNode* start = lastNode;
+		while (NULL != start) {
+			// The subtree's upper bound is the first ancestor reached through a left child
+			RBNode* bound = start;
+			while (NULL != RBNode_getParent(bound) && bound == RBNode_getRightChild(RBNode_getParent(bound))) {
+				bound = RBNode_getParent(bound);
+			}
+			bound = RBNode_getParent(bound);
+			if (NULL == bound || RBTree_compareKeys(tree, RBNode_getKey(bound), entries[i].key) < 0) {
+				break;
+			}
+			start = bound;
+		}
+		lastNode = RBTree_insertFrom(tree, start, entries[i].key, entries[i].value);
+	}
+	free(entries);
+	return 0;
+}
+
+int RBTree_reserveNodes(RBTree* tree, int n) {
+	// Puts at least n nodes on the tree's free list, so the next n inserts allocate nothing
+	if (NULL == tree) {
+		return 1;
+	}
+	RBNode* reserved = NULL;
+	int failed = 0;
+	for (int i = 0; i < n; i++) {
+		RBNode* node = RBTree_createNode(tree, RED, NULL, NULL, NULL, NULL, NULL);
+		if (NULL == node) {
+			failed = 1;
+			break;
+		}
+		node->parent = reserved;
+		reserved = node;
+	}
+	// Taken nodes go back either way, a failed reservation only leaves them cached
+	while (NULL != reserved) {
+		RBNode* nextNode = reserved->parent;
+		RBTree_deleteNode(tree, reserved);
+		reserved = nextNode;
+	}
+	return failed;
+}
+
+void RBTree_sortEntries(RBTree* tree, RBTreeEntry* entries, RBTreeEntry* scratch, int n) {
+	if (2 > n) {
+		return;
+	}
+	// Merge sort the halves, then merge them through the scratch space
+	int mid = n / 2;
+	RBTree_sortEntries(tree, entries, scratch, mid);
+	RBTree_sortEntries(tree, entries + mid, scratch, n - mid);
+	if (0 <= RBTree_compareKeys(tree, entries[mid - 1].key, entries[mid].key)) {
+		// Halves are already in order
+		return;
+	}
+	int left = 0;
+	int right = mid;
+	for (int i = 0; i < n; i++) {
+		if (right == n || (left < mid && 0 >= RBTree_compareKeys(tree, entries[right].key, entries[left].key))) {
+			scratch[i] = entries[left++];
+		} else {
+			scratch[i] = entries[right++];
+		}
+	}
+	for (int i = 0; i < n; i++) {
+		entries[i] = scratch[i];
+	}
 }
 
 void RBTree_repairAfterInsert(RBTree* tree, RBNode* node) {
@@ -635,38 +1251,38 @@ void RBTree_repairAfterInsert(RBTree* tree, RBNode* node) {
 		if (RBNode_getParent(node) == RBNode_getLeftChild(RBNode_getParent(RBNode_getParent(node)))) {
 			RBNode* uncle = RBNode_getRightChild(RBNode_getParent(RBNode_getParent(node)));
 			if (RBNode_getColor(uncle) == RED) {
-				RBNode_setColor(RBNode_getParent(node), BLACK);
-				RBNode_setColor(uncle, BLACK);
-				RBNode_setColor(RBNode_getParent(RBNode_getParent(node)), RED);
+				RBTree_recolor(tree, RBNode_getParent(node), BLACK);
+				RBTree_recolor(tree, uncle, BLACK);
+				RBTree_recolor(tree, RBNode_getParent(RBNode_getParent(node)), RED);
 				node = RBNode_getParent(RBNode_getParent(node));
 			} else {
 				if (node == RBNode_getRightChild(RBNode_getParent(node))) {
 					node = RBNode_getParent(node);
 					RBTree_rotateLeft(tree, node);
 				}
-				RBNode_setColor(RBNode_getParent(node), BLACK);
-				RBNode_setColor(RBNode_getParent(RBNode_getParent(node)), RED);
+				RBTree_recolor(tree, RBNode_getParent(node), BLACK);
+				RBTree_recolor(tree, RBNode_getParent(RBNode_getParent(node)), RED);
 				RBTree_rotateRight(tree, RBNode_getParent(RBNode_getParent(node)));
 			}
 		} else {
 			RBNode* uncle = RBNode_getLeftChild(RBNode_getParent(RBNode_getParent(node)));
 			if (RBNode_getColor(uncle) == RED) {
-				RBNode_setColor(RBNode_getParent(node), BLACK);
-				RBNode_setColor(uncle, BLACK);
-				RBNode_setColor(RBNode_getParent(RBNode_getParent(node)), RED);
+				RBTree_recolor(tree, RBNode_getParent(node), BLACK);
+				RBTree_recolor(tree, uncle, BLACK);
+				RBTree_recolor(tree, RBNode_getParent(RBNode_getParent(node)), RED);
 				node = RBNode_getParent(RBNode_getParent(node));
 			} else {
 				if (node == RBNode_getLeftChild(RBNode_getParent(node))) {
 					node = RBNode_getParent(node);
 					RBTree_rotateRight(tree, node);
 				}
-				RBNode_setColor(RBNode_getParent(node), BLACK);
-				RBNode_setColor(RBNode_getParent(RBNode_getParent(node)), RED);
+				RBTree_recolor(tree, RBNode_getParent(node), BLACK);
+				RBTree_recolor(tree, RBNode_getParent(RBNode_getParent(node)), RED);
 				RBTree_rotateLeft(tree, RBNode_getParent(RBNode_getParent(node)));
 			}
 		}
 	}
-	RBNode_setColor(RBTree_getRoot(tree), BLACK);
+	RBTree_recolor(tree, RBTree_getRoot(tree), BLACK);
 }
 
 void* RBTree_search(RBTree* tree, void* key) {
@@ -674,153 +1290,2491 @@ void* RBTree_search(RBTree* tree, void* key) {
 		return NULL;
 	}
 	RBNode* currNode = RBTree_getRoot(tree);
+	int visited = 0;
+	RBTREE_COUNT(tree, searches, 1);
 	while (NULL != currNode) {
-		switch(RBTree_compareKeys(tree, RBNode_getKey(currNode), key)) {
-			case 0:
-				return RBNode_getValue(currNode);
-			case -1:
-				currNode = RBNode_getLeftChild(currNode);
-				break;
-			case 1:
-				currNode = RBNode_getRightChild(currNode);
-				break;
-			default:
-				return NULL;  // NEVER SHOULD HAVE COME HERE!
+		visited++;
+		// Only the sign of the comparison counts, as in every other lookup
+		int order = RBTree_compareKeys(tree, RBNode_getKey(currNode), key);
+		if (0 == order) {
+			RBTREE_COUNT(tree, searchVisits, visited);
+			return RBNode_getValue(currNode);
 		}
+		currNode = (0 > order) ? RBNode_getLeftChild(currNode) : RBNode_getRightChild(currNode);
 	}
+	RBTREE_COUNT(tree, searchVisits, visited);
 	return NULL;
 }
 
-int RBTree_remove(RBTree* tree, void* key) {
-	// TODO: Implement this if you want to make it a nice library
-	return 1;
-}
-
-void RBTree_repairAfterRemove(RBTree* tree) {
-	// TODO: Implement this if you want to make this a nice library
-	;
-}
-
-void RBTree_rotateLeft(RBTree* tree, RBNode* node) {
-	if (NULL == tree || NULL == node) {
-		return;
-	}
-	// Get the new subtree root
-	RBNode* newParent = RBNode_getRightChild(node);
-	// Move the left child of the new subtree root as the right child of the old subtree root
-	RBNode_setRightChild(node, RBNode_getLeftChild(newParent));
-	RBNode_setParent(RBNode_getLeftChild(newParent), node);
-	// Set the subtree root to the new subtree root
-	RBNode_setParent(newParent, RBNode_getParent(node));
-	if (NULL == RBNode_getParent(node)) {
-		// If the old subtree was the root of the tree, set the new root as such
-		RBTree_setRoot(tree, newParent);
-	} else if (node == RBNode_getLeftChild(RBNode_getParent(node))) {
-		// If the old subtree root was the left child of its parent, set the new subtree root as such
-		RBNode_setLeftChild(RBNode_getParent(node), newParent);
-	} else {
-		// If the old subtree root was the right child of its parent, set the new subtree root as such
-		RBNode_setRightChild(RBNode_getParent(node), newParent);
+LinkedList* RBTree_searchGroup(RBTree* tree, void* key) {
+	if (NULL == tree || !tree->multimap) {
+		return NULL;
 	}
-	// Set the old subtree root as the left child of the new subtree root
-	RBNode_setLeftChild(newParent, node);
-	RBNode_setParent(node, newParent);
+	return RBTree_search(tree, key);
 }
 
-void RBTree_rotateRight(RBTree* tree, RBNode* node) {
-	if (NULL == tree || NULL == node) {
-		return;
+int RBTree_searchBatch(RBTree* tree, void** keys, void** values, int n) {
+	if (NULL == tree || NULL == keys || NULL == values || 0 > n) {
+		return 1;
 	}
-	// Get the new subtree root
-	RBNode* newParent = RBNode_getLeftChild(node);
-	// Move the right child of the new subtree root as the left child of the old subtree root
-	RBNode_setLeftChild(node, RBNode_getRightChild(newParent));
-	RBNode_setParent(RBNode_getRightChild(newParent), node);
-	// Set the subtree root to the new subtree root
-	RBNode_setParent(newParent, RBNode_getParent(node));
-	if (NULL == RBNode_getParent(node)) {
-		// If the old subtree was the root of the tree, set the new root as such
-		RBTree_setRoot(tree, newParent);
-	} else if (node == RBNode_getRightChild(RBNode_getParent(node))) {
-		// If the old subtree root was the right child of its parent, set the new subtree root as such
-		RBNode_setRightChild(RBNode_getParent(node), newParent);
-	} else {
-		// If the old subtree root was the left child of its parent, set the new subtree root as such
-		RBNode_setLeftChild(RBNode_getParent(node), newParent);
+	RBNode* currNodes[RBTREE_SEARCH_GROUP];
+	for (int first = 0; first < n; first += RBTREE_SEARCH_GROUP) {
+		int count = (n - first < RBTREE_SEARCH_GROUP) ? n - first : RBTREE_SEARCH_GROUP;
+		for (int i = 0; i < count; i++) {
+			currNodes[i] = (NULL == keys[first + i]) ? NULL : RBTree_getRoot(tree);
+			values[first + i] = NULL;
+		}
+		// Advance every lookup one level per pass, so their cache misses overlap
+		int active = count;
+		while (0 < active) {
+			// The nodes were prefetched last pass, fetch their keys before comparing
+			for (int i = 0; i < count; i++) {
+				if (NULL != currNodes[i]) {
+					RBTREE_PREFETCH(currNodes[i]->key);
+				}
+			}
+			active = 0;
+			for (int i = 0; i < count; i++) {
+				RBNode* currNode = currNodes[i];
+				if (NULL == currNode) {
+					continue;
+				}
+				int order = RBTree_compareKeys(tree, RBNode_getKey(currNode), keys[first + i]);
+				if (0 == order) {
+					values[first + i] = RBNode_getValue(currNode);
+					currNodes[i] = NULL;
+					continue;
+				}
+				currNode = currNode->children[(0 > order) ? 0 : 1];
+				if (NULL != currNode) {
+					RBTREE_PREFETCH(currNode);
+					active++;
+				}
+				currNodes[i] = currNode;
+			}
+		}
 	}
-	// Set the old subtree root as the right child of the new subtree root
-	RBNode_setRightChild(newParent, node);
-	RBNode_setParent(node, newParent);
+	return 0;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-//
-// START RBTreeIterator FUNCTION DEFINITIONS
-//
-////////////////////////////////////////////////////////////////////////////////
-
-RBTreeIterator* RBTreeIterator_create(RBTree* tree) {
-	RBTreeIterator* newIter = malloc(sizeof(RBTreeIterator));
-	if (newIter == NULL) {
-		return NULL;
-	}
-	newIter->tree = tree;
-	newIter->currNode = NULL;
-	newIter->nextNode = RBTree_getRoot(tree);
-	while (NULL != RBNode_getLeftChild(newIter->nextNode)) {
-		newIter->nextNode = RBNode_getLeftChild(newIter->nextNode);
-	}
-	return newIter;
+int RBTree_forEach(RBTree* tree, Visitor visitFunction, void* context) {
+	return RBTree_forEachInDirection(tree, visitFunction, context, 0);
 }
 
-void* RBTreeIterator_getKey(RBTreeIterator* iter) {
-	if (NULL == iter) {
-		return NULL;
-	}
-	return RBNode_getKey(iter->currNode);
+int RBTree_forEachReverse(RBTree* tree, Visitor visitFunction, void* context) {
+	return RBTree_forEachInDirection(tree, visitFunction, context, 1);
 }
 
-void* RBTreeIterator_getValue(RBTreeIterator* iter) {
-	if (NULL == iter) {
-		return NULL;
+int RBTree_forEachInDirection(RBTree* tree, Visitor visitFunction, void* context, int reverse) {
+	// Returns the visitor's nonzero result if it stopped the walk early, otherwise 0
+	if (NULL == tree || NULL == visitFunction) {
+		return 0;
 	}
-	return RBNode_getValue(iter->currNode);
+	// Walk with an explicit stack of pending ancestors instead of climbing parent pointers
+	RBNode* stack[RBTREE_MAX_HEIGHT];
+	int depth = 0;
+	RBNode* currNode = RBTree_getRoot(tree);
+	while (NULL != currNode || 0 < depth) {
+		while (NULL != currNode) {
+			stack[depth++] = currNode;
+			currNode = currNode->children[reverse];
+		}
+		currNode = stack[--depth];
+		int result = visitFunction(currNode->key, currNode->value, context);
+		if (0 != result) {
+			return result;
+		}
+		currNode = currNode->children[1 - reverse];
+	}
+	return 0;
 }
 
-int RBTreeIterator_hasNext(RBTreeIterator* iter) {
+int RBTree_remove(RBTree* tree, void* key) {
+	if (NULL == tree || NULL == key) {
+		return 1;
+	}
+	RBNode* currNode = RBTree_getRoot(tree);
+	while (NULL != currNode) {
+		int order = RBTree_compareKeys(tree, RBNode_getKey(currNode), key);
+		if (0 == order) {
+			break;
+		}
+		currNode = (0 > order) ? RBNode_getLeftChild(currNode) : RBNode_getRightChild(currNode);
+	}
+	if (NULL == currNode) {
+		return 1;
+	}
+	RBTree_removeNode(tree, currNode);
+	tree->size--;
+	RBTree_destroyEntry(tree, currNode);
+	RBTree_deleteNode(tree, currNode);
+	return 0;
+}
+
+int RBTree_removeValue(RBTree* tree, void* key, void* value) {
+	// Drops the first occurrence of value from the group of key, and the key once its group is empty
+	LinkedList* group = RBTree_searchGroup(tree, key);
+	if (NULL == group || NULL == value) {
+		return 1;
+	}
+	int index = 0;
+	LinkedListIterator iter;
+	LinkedListIterator_init(&iter, group);
+	while (LinkedListIterator_hasNext(&iter)) {
+		LinkedListIterator_getNext(&iter);
+		if (value == LinkedListIterator_getValue(&iter)) {
+			break;
+		}
+		index++;
+	}
+	if (index == LinkedList_size(group)) {
+		return 1;
+	}
+	if (1 == LinkedList_size(group)) {
+		return RBTree_remove(tree, key);
+	}
+	LinkedList_remove(group, index);
+	if (NULL != tree->valueDestructor) {
+		tree->valueDestructor(value);
+	}
+	return 0;
+}
+
+void RBTree_removeNode(RBTree* tree, RBNode* node) {
+	// Unlinks node and rebalances, leaving tree->size to the caller
+	if (NULL == tree || NULL == node) {
+		return;
+	}
+	// The node that actually leaves its position, and the child that moves into it
+	RBNode* removed = node;
+	RBNodeColor removedColor = RBNode_getColor(removed);
+	RBNode* child;
+	RBNode* childParent;
+	if (NULL == RBNode_getLeftChild(node)) {
+		child = RBNode_getRightChild(node);
+		childParent = RBNode_getParent(node);
+		RBTree_transplant(tree, node, child);
+	} else if (NULL == RBNode_getRightChild(node)) {
+		child = RBNode_getLeftChild(node);
+		childParent = RBNode_getParent(node);
+		RBTree_transplant(tree, node, child);
+	} else {
+		// Two children, the successor takes the node's place and color
+		removed = RBNode_getRightChild(node);
+		while (NULL != RBNode_getLeftChild(removed)) {
+			removed = RBNode_getLeftChild(removed);
+		}
+		removedColor = RBNode_getColor(removed);
+		child = RBNode_getRightChild(removed);
+		if (RBNode_getParent(removed) == node) {
+			childParent = removed;
+		} else {
+			childParent = RBNode_getParent(removed);
+			RBTree_transplant(tree, removed, child);
+			RBNode_setRightChild(removed, RBNode_getRightChild(node));
+			RBNode_setParent(RBNode_getRightChild(removed), removed);
+		}
+		RBTree_transplant(tree, node, removed);
+		RBNode_setLeftChild(removed, RBNode_getLeftChild(node));
+		RBNode_setParent(RBNode_getLeftChild(removed), removed);
+		RBNode_setColor(removed, RBNode_getColor(node));
+		RBNode_setSize(removed, RBNode_getSize(node));
+	}
+	if (tree->augmented) {
+		for (RBNode* currNode = childParent; NULL != currNode; currNode = RBNode_getParent(currNode)) {
+			RBNode_setSize(currNode, RBNode_getSize(currNode) - 1);
+		}
+	}
+	// Taking a black node out shortens one side, restore the black height
+	if (BLACK == removedColor) {
+		RBTree_repairAfterRemove(tree, child, childParent);
+	}
+}
+
+void RBTree_repairAfterRemove(RBTree* tree, RBNode* node, RBNode* parent) {
+	if (NULL == tree) {
+		return;
+	}
+	// node carries an extra black, push it up or absorb it with rotations
+	while (node != RBTree_getRoot(tree) && RBNode_getColor(node) != RED) {
+		if (node == RBNode_getLeftChild(parent)) {
+			RBNode* sibling = RBNode_getRightChild(parent);
+			if (RBNode_getColor(sibling) == RED) {
+				RBTree_recolor(tree, sibling, BLACK);
+				RBTree_recolor(tree, parent, RED);
+				RBTree_rotateLeft(tree, parent);
+				sibling = RBNode_getRightChild(parent);
+			}
+			if (RBNode_getColor(RBNode_getLeftChild(sibling)) != RED && RBNode_getColor(RBNode_getRightChild(sibling)) != RED) {
+				RBTree_recolor(tree, sibling, RED);
+				node = parent;
+				parent = RBNode_getParent(node);
+			} else {
+				if (RBNode_getColor(RBNode_getRightChild(sibling)) != RED) {
+					RBTree_recolor(tree, RBNode_getLeftChild(sibling), BLACK);
+					RBTree_recolor(tree, sibling, RED);
+					RBTree_rotateRight(tree, sibling);
+					sibling = RBNode_getRightChild(parent);
+				}
+				RBTree_recolor(tree, sibling, RBNode_getColor(parent));
+				RBTree_recolor(tree, parent, BLACK);
+				RBTree_recolor(tree, RBNode_getRightChild(sibling), BLACK);
+				RBTree_rotateLeft(tree, parent);
+				node = RBTree_getRoot(tree);
+				parent = NULL;
+			}
+		} else {
+			RBNode* sibling = RBNode_getLeftChild(parent);
+			if (RBNode_getColor(sibling) == RED) {
+				RBTree_recolor(tree, sibling, BLACK);
+				RBTree_recolor(tree, parent, RED);
+				RBTree_rotateRight(tree, parent);
+				sibling = RBNode_getLeftChild(parent);
+			}
+			if (RBNode_getColor(RBNode_getLeftChild(sibling)) != RED && RBNode_getColor(RBNode_getRightChild(sibling)) != RED) {
+				RBTree_recolor(tree, sibling, RED);
+				node = parent;
+				parent = RBNode_getParent(node);
+			} else {
+				if (RBNode_getColor(RBNode_getLeftChild(sibling)) != RED) {
+					RBTree_recolor(tree, RBNode_getRightChild(sibling), BLACK);
+					RBTree_recolor(tree, sibling, RED);
+					RBTree_rotateLeft(tree, sibling);
+					sibling = RBNode_getLeftChild(parent);
+				}
+				RBTree_recolor(tree, sibling, RBNode_getColor(parent));
+				RBTree_recolor(tree, parent, BLACK);
+				RBTree_recolor(tree, RBNode_getLeftChild(sibling), BLACK);
+				RBTree_rotateRight(tree, parent);
+				node = RBTree_getRoot(tree);
+				parent = NULL;
+			}
+		}
+	}
+	RBTree_recolor(tree, node, BLACK);
+}
+
+void RBTree_transplant(RBTree* tree, RBNode* node, RBNode* replacement) {
+	// Hangs replacement where node was, leaving node's children alone
+	if (NULL == RBNode_getParent(node)) {
+		RBTree_setRoot(tree, replacement);
+	} else if (node == RBNode_getLeftChild(RBNode_getParent(node))) {
+		RBNode_setLeftChild(RBNode_getParent(node), replacement);
+	} else {
+		RBNode_setRightChild(RBNode_getParent(node), replacement);
+	}
+	RBNode_setParent(replacement, RBNode_getParent(node));
+}
+
+int RBTree_popMin(RBTree* tree, void** key, void** value) {
+	RBNode* minNode = RBTree_getRoot(tree);
+	if (NULL == minNode) {
+		return 1;
+	}
+	while (NULL != RBNode_getLeftChild(minNode)) {
+		minNode = RBNode_getLeftChild(minNode);
+	}
+	if (NULL != key) {
+		*key = RBNode_getKey(minNode);
+	}
+	if (NULL != value) {
+		*value = RBNode_getValue(minNode);
+	}
+	RBTree_removeNode(tree, minNode);
+	tree->size--;
+	RBTree_deleteNode(tree, minNode);
+	return 0;
+}
+
+int RBTree_popMax(RBTree* tree, void** key, void** value) {
+	RBNode* maxNode = RBTree_getRoot(tree);
+	if (NULL == maxNode) {
+		return 1;
+	}
+	while (NULL != RBNode_getRightChild(maxNode)) {
+		maxNode = RBNode_getRightChild(maxNode);
+	}
+	if (NULL != key) {
+		*key = RBNode_getKey(maxNode);
+	}
+	if (NULL != value) {
+		*value = RBNode_getValue(maxNode);
+	}
+	RBTree_removeNode(tree, maxNode);
+	tree->size--;
+	RBTree_deleteNode(tree, maxNode);
+	return 0;
+}
+
+int RBTree_canShareNodes(RBTree* tree, RBTree* other) {
+	// Nodes can only move between trees that allocate, order and augment them alike
+	if (NULL == tree || NULL == other || tree == other) {
+		return 0;
+	}
+	return (NULL == tree->arena) == (NULL == other->arena)
+		&& tree->augmented == other->augmented
+		&& tree->multimap == other->multimap
+		&& tree->keyCompareFunction == other->keyCompareFunction;
+}
+
+int RBTree_canCombine(RBTree* tree, RBTree* other, int keepIfPresent) {
+	// A union moves the nodes of other into tree, intersect and difference only search other.
+	// Multimaps are refused a union, which would leave a key shared by both trees with two groups.
+	if (0 > keepIfPresent) {
+		return RBTree_canShareNodes(tree, other) && !tree->multimap;
+	}
+	return NULL != tree && NULL != other && tree != other;
+}
+
+void RBTree_takeNodes(RBTree* tree, RBTree* other) {
+	// Hands the allocator state of other to tree once its nodes were relinked, leaving other empty
+	if (NULL != tree->arena) {
+		RBNodeArena_adopt(tree->arena, other->arena);
+	}
+	while (NULL != other->freeNodes) {
+		RBNode* nextNode = other->freeNodes->parent;
+		RBTree_deleteNode(tree, other->freeNodes);
+		other->freeNodes = nextNode;
+	}
+	RBTree_setRoot(other, NULL);
+	other->size = 0;
+}
+
+void RBTree_initScratch(RBTree* scratch, RBTree* tree, RBNode* root) {
+	// A stack tree for rotating detached subtrees, it owns no allocator or lock and only
+	// goes through RBTree_repairAfterInsert and RBTree_removeNode, which leave size alone
+	scratch->root = root;
+	scratch->keyCompareFunction = tree->keyCompareFunction;
+	scratch->arena = NULL;
+	scratch->freeNodes = NULL;
+	scratch->size = 0;
+	scratch->augmented = tree->augmented;
+	scratch->multimap = tree->multimap;
+	scratch->keyDestructor = tree->keyDestructor;
+	scratch->valueDestructor = tree->valueDestructor;
+	RBTree_resetStats(scratch);
+}
+
+int RBTree_join(RBTree* left, void* key, void* value, RBTree* right) {
+	// Joins left, key and right, whose keys must ascend in that order, into left and deletes right
+	if (NULL == key || NULL == value || !RBTree_canShareNodes(left, right)) {
+		return 1;
+	}
+	RBNode* leftMax = RBTree_getRoot(left);
+	while (NULL != RBNode_getRightChild(leftMax)) {
+		leftMax = RBNode_getRightChild(leftMax);
+	}
+	RBNode* rightMin = RBTree_getRoot(right);
+	while (NULL != RBNode_getLeftChild(rightMin)) {
+		rightMin = RBNode_getLeftChild(rightMin);
+	}
+	// A multimap holds one group per key, so there key must lie strictly between the two trees
+	int strict = left->multimap;
+	if ((NULL != leftMax && strict > RBTree_compareKeys(left, RBNode_getKey(leftMax), key))
+		|| (NULL != rightMin && strict > RBTree_compareKeys(left, key, RBNode_getKey(rightMin)))) {
+		return 1;
+	}
+	LinkedList* group = NULL;
+	if (left->multimap) {
+		group = LinkedList_create();
+		if (NULL == group || 0 != LinkedList_append(group, value)) {
+			LinkedList_delete(group);
+			return 1;
+		}
+		value = group;
+	}
+	RBNode* middle = RBTree_createNode(left, RED, NULL, NULL, NULL, key, value);
+	if (NULL == middle) {
+		LinkedList_delete(group);
+		return 1;
+	}
+	RBTree_setRoot(left, RBTree_joinNodes(left, left->root, middle, right->root));
+	left->size = left->size + right->size + 1;
+	RBTree_takeNodes(left, right);
+	RBTree_delete(right);
+	return 0;
+}
+
+RBTree* RBTree_split(RBTree* tree, void* key) {
+	// Keeps the keys less than key in tree and returns a new tree with the rest
+	if (NULL == tree || NULL == key) {
+		return NULL;
+	}
+	RBTree* newTree = RBTree_create(tree->keyCompareFunction);
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->augmented = tree->augmented;
+	newTree->multimap = tree->multimap;
+	RBTree_setDestructors(newTree, tree->keyDestructor, tree->valueDestructor);
+	newTree->arena = RBNodeArena_retain(tree->arena);
+	RBTree_splitNodes(tree, tree->root, key, &tree->root, &newTree->root);
+	if (tree->augmented) {
+		tree->size = RBNode_getSize(tree->root);
+		newTree->size = RBNode_getSize(newTree->root);
+	} else {
+		int total = tree->size;
+		tree->size = RBTree_countFirstHalf(tree->root, newTree->root, total);
+		newTree->size = total - tree->size;
+	}
+	return newTree;
+}
+
+int RBTree_countFirstHalf(RBNode* first, RBNode* second, int total) {
+	// Counts the nodes under first, given total under both, by walking both in step until one runs out.
+	// Without subtree sizes a split thus pays O(min(k, n - k)) to keep its sizes exact.
+	while (NULL != RBNode_getLeftChild(first)) {
+		first = RBNode_getLeftChild(first);
+	}
+	while (NULL != RBNode_getLeftChild(second)) {
+		second = RBNode_getLeftChild(second);
+	}
+	int steps = 0;
+	while (NULL != first && NULL != second) {
+		first = RBNode_getSuccessor(first);
+		second = RBNode_getSuccessor(second);
+		steps++;
+	}
+	return (NULL == first) ? steps : total - steps;
+}
+
+int RBTree_union(RBTree* tree, RBTree* other) {
+	// Moves every node of other into tree, keeping equal keys from both, and deletes other
+	if (0 != RBTree_combine(tree, other, -1, 1)) {
+		return 1;
+	}
+	RBTree_delete(other);
+	return 0;
+}
+
+int RBTree_intersect(RBTree* tree, RBTree* other) {
+	// Drops the nodes of tree whose key is not in other, other is left as is
+	return RBTree_combine(tree, other, 1, 1);
+}
+
+int RBTree_difference(RBTree* tree, RBTree* other) {
+	// Drops the nodes of tree whose key is in other, other is left as is
+	return RBTree_combine(tree, other, 0, 1);
+}
+
+int RBTree_combine(RBTree* tree, RBTree* other, int keepIfPresent, int threads) {
+	// keepIfPresent is -1 to union (leaving other empty), 1 to intersect and 0 to take the difference
+	if (!RBTree_canCombine(tree, other, keepIfPresent)) {
+		return 1;
+	}
+	RBTreeTask task;
+	task.tree = tree;
+	task.first = tree->root;
+	task.second = (0 > keepIfPresent) ? other->root : NULL;
+	task.filter = (0 > keepIfPresent) ? NULL : other;
+	task.keepIfPresent = keepIfPresent;
+	task.threads = (1 > threads) ? 1 : threads;
+	task.discarded = (RBNodeChain){ NULL, NULL, 0 };
+	RBTree_combineNodes(&task);
+	RBTree_setRoot(tree, task.result);
+	if (0 > keepIfPresent) {
+		tree->size = tree->size + other->size;
+		RBTree_takeNodes(tree, other);
+		return 0;
+	}
+	tree->size -= task.discarded.count;
+	while (NULL != task.discarded.head) {
+		RBNode* nextNode = task.discarded.head->parent;
+		RBTree_destroyEntry(tree, task.discarded.head);
+		RBTree_deleteNode(tree, task.discarded.head);
+		task.discarded.head = nextNode;
+	}
+	return 0;
+}
+
+int RBNode_getBlackHeight(RBNode* node) {
+	// Black nodes from node down to a leaf, counting node itself
+	int height = 0;
+	for (; NULL != node; node = RBNode_getLeftChild(node)) {
+		if (RBNode_getColor(node) != RED) {
+			height++;
+		}
+	}
+	return height;
+}
+
+RBNode* RBTree_joinNodes(RBTree* tree, RBNode* left, RBNode* middle, RBNode* right) {
+	// Joins two detached subtrees around middle, every key of left <= middle <= every key of right
+	RBTree_recolor(tree, left, BLACK);
+	RBTree_recolor(tree, right, BLACK);
+	int leftHeight = RBNode_getBlackHeight(left);
+	int rightHeight = RBNode_getBlackHeight(right);
+	RBNode_setSize(middle, RBNode_getSize(left) + RBNode_getSize(right) + 1);
+	if (leftHeight == rightHeight) {
+		RBTree_recolor(tree, middle, BLACK);
+		RBNode_setParent(middle, NULL);
+		RBNode_setLeftChild(middle, left);
+		RBNode_setRightChild(middle, right);
+		RBNode_setParent(left, middle);
+		RBNode_setParent(right, middle);
+		return middle;
+	}
+	// Walk down the spine of the taller tree to a black node as high as the shorter tree
+	int side = (leftHeight > rightHeight) ? 1 : 0;
+	RBNode* taller = side ? left : right;
+	RBNode* shorter = side ? right : left;
+	int shorterHeight = side ? rightHeight : leftHeight;
+	int height = side ? leftHeight : rightHeight;
+	RBNode* parent = NULL;
+	RBNode* currNode = taller;
+	while (RBNode_getColor(currNode) == RED || height != shorterHeight) {
+		if (RBNode_getColor(currNode) != RED) {
+			height--;
+		}
+		parent = currNode;
+		currNode = currNode->children[side];
+	}
+	// Hang middle in its place as a red node holding both subtrees
+	RBTree_recolor(tree, middle, RED);
+	RBNode_setParent(middle, parent);
+	RBTREE_STORE(middle->children[side], shorter);
+	RBTREE_STORE(middle->children[1 - side], currNode);
+	RBNode_setSize(middle, RBNode_getSize(currNode) + RBNode_getSize(shorter) + 1);
+	RBTREE_STORE(parent->children[side], middle);
+	RBNode_setParent(currNode, middle);
+	RBNode_setParent(shorter, middle);
+	RBTree scratch;
+	RBTree_initScratch(&scratch, tree, taller);
+	RBTree_updateSizesUpward(&scratch, middle, RBNode_getSize(shorter) + 1);
+	RBTree_repairAfterInsert(&scratch, middle);
+	RBTree_addStats(tree, &scratch);
+	return scratch.root;
+}
+
+RBNode* RBTree_join2Nodes(RBTree* tree, RBNode* left, RBNode* right) {
+	// Joins two detached subtrees without a middle node, using the minimum of right instead
+	if (NULL == left) {
+		return right;
+	}
+	if (NULL == right) {
+		return left;
+	}
+	RBTree scratch;
+	RBTree_initScratch(&scratch, tree, right);
+	RBNode* middle = right;
+	while (NULL != RBNode_getLeftChild(middle)) {
+		middle = RBNode_getLeftChild(middle);
+	}
+	RBTree_removeNode(&scratch, middle);
+	RBTree_addStats(tree, &scratch);
+	RBNode_setParent(scratch.root, NULL);
+	return RBTree_joinNodes(tree, left, middle, scratch.root);
+}
+
+void RBTree_splitNodes(RBTree* tree, RBNode* node, void* key, RBNode** less, RBNode** greater) {
+	// Splits a detached subtree into the keys less than key and the rest
+	if (NULL == node) {
+		*less = NULL;
+		*greater = NULL;
+		return;
+	}
+	RBNode* left = RBNode_getLeftChild(node);
+	RBNode* right = RBNode_getRightChild(node);
+	RBNode_setParent(left, NULL);
+	RBNode_setParent(right, NULL);
+	if (0 < RBTree_compareKeys(tree, RBNode_getKey(node), key)) {
+		RBNode* rightLess;
+		RBTree_splitNodes(tree, right, key, &rightLess, greater);
+		*less = RBTree_joinNodes(tree, left, node, rightLess);
+	} else {
+		RBNode* leftGreater;
+		RBTree_splitNodes(tree, left, key, less, &leftGreater);
+		*greater = RBTree_joinNodes(tree, leftGreater, node, right);
+	}
+}
+
+void* RBTree_combineNodes(void* arg) {
+	RBTreeTask* task = arg;
+	RBNode* node = (0 > task->keepIfPresent) ? task->second : task->first;
+	if (NULL == node || NULL == task->first) {
+		task->result = (0 > task->keepIfPresent) ? ((NULL == node) ? task->first : task->second) : NULL;
+		return NULL;
+	}
+	// Union splits the first subtree around the root of the second, the filters recurse on the first alone
+	RBTreeTask halves[2];
+	halves[0] = *task;
+	halves[1] = *task;
+	halves[0].threads = task->threads / 2;
+	halves[1].threads = task->threads - halves[0].threads;
+	halves[0].discarded = (RBNodeChain){ NULL, NULL, 0 };
+	halves[1].discarded = (RBNodeChain){ NULL, NULL, 0 };
+	RBNode* left = RBNode_getLeftChild(node);
+	RBNode* right = RBNode_getRightChild(node);
+	RBNode_setParent(left, NULL);
+	RBNode_setParent(right, NULL);
+	if (0 > task->keepIfPresent) {
+		RBTree_splitNodes(task->tree, task->first, RBNode_getKey(node), &halves[0].first, &halves[1].first);
+		halves[0].second = left;
+		halves[1].second = right;
+	} else {
+		halves[0].first = left;
+		halves[1].first = right;
+	}
+	// Fork the left half onto a new thread while this one takes the right half
+	pthread_t thread;
+	int forked = (0 < halves[0].threads) && (0 == pthread_create(&thread, NULL, RBTree_combineNodes, &halves[0]));
+	if (!forked) {
+		RBTree_combineNodes(&halves[0]);
+	}
+	RBTree_combineNodes(&halves[1]);
+	if (forked) {
+		pthread_join(thread, NULL);
+	}
+	task->discarded = (RBNodeChain){ NULL, NULL, 0 };
+	RBNodeChain_append(&task->discarded, &halves[0].discarded);
+	RBNodeChain_append(&task->discarded, &halves[1].discarded);
+	if (0 <= task->keepIfPresent && (NULL != RBTree_search(task->filter, RBNode_getKey(node))) != task->keepIfPresent) {
+		RBNodeChain dropped = { node, node, 1 };
+		node->parent = NULL;
+		RBNodeChain_append(&task->discarded, &dropped);
+		task->result = RBTree_join2Nodes(task->tree, halves[0].result, halves[1].result);
+	} else {
+		task->result = RBTree_joinNodes(task->tree, halves[0].result, node, halves[1].result);
+	}
+	return NULL;
+}
+
+void RBNodeChain_append(RBNodeChain* chain, RBNodeChain* other) {
+	if (NULL == other->head) {
+		return;
+	}
+	if (NULL == chain->head) {
+		chain->head = other->head;
+	} else {
+		chain->tail->parent = other->head;
+	}
+	chain->tail = other->tail;
+	chain->count += other->count;
+}
+
+void RBTree_rotateLeft(RBTree* tree, RBNode* node) {
+	if (NULL == tree || NULL == node) {
+		return;
+	}
+	RBTREE_COUNT(tree, leftRotations, 1);
+	// Get the new subtree root
+	RBNode* newParent = RBNode_getRightChild(node);
+	// Move the left child of the new subtree root as the right child of the old subtree root
+	RBNode_setRightChild(node, RBNode_getLeftChild(newParent));
+	RBNode_setParent(RBNode_getLeftChild(newParent), node);
+	// Set the subtree root to the new subtree root
+	RBNode_setParent(newParent, RBNode_getParent(node));
+	if (NULL == RBNode_getParent(node)) {
+		// If the old subtree was the root of the tree, set the new root as such
+		RBTree_setRoot(tree, newParent);
+	} else if (node == RBNode_getLeftChild(RBNode_getParent(node))) {
+		// If the old subtree root was the left child of its parent, set the new subtree root as such
+		RBNode_setLeftChild(RBNode_getParent(node), newParent);
+	} else {
+		// If the old subtree root was the right child of its parent, set the new subtree root as such
+		RBNode_setRightChild(RBNode_getParent(node), newParent);
+	}
+	// Set the old subtree root as the left child of the new subtree root
+	RBNode_setLeftChild(newParent, node);
+	RBNode_setParent(node, newParent);
+	if (tree->augmented) {
+		// The new subtree root takes over the whole subtree
+		RBNode_setSize(newParent, RBNode_getSize(node));
+		RBNode_setSize(node, RBNode_getSize(RBNode_getLeftChild(node)) + RBNode_getSize(RBNode_getRightChild(node)) + 1);
+	}
+}
+
+void RBTree_rotateRight(RBTree* tree, RBNode* node) {
+	if (NULL == tree || NULL == node) {
+		return;
+	}
+	RBTREE_COUNT(tree, rightRotations, 1);
+	// Get the new subtree root
+	RBNode* newParent = RBNode_getLeftChild(node);
+	// Move the right child of the new subtree root as the left child of the old subtree root
+	RBNode_setLeftChild(node, RBNode_getRightChild(newParent));
+	RBNode_setParent(RBNode_getRightChild(newParent), node);
+	// Set the subtree root to the new subtree root
+	RBNode_setParent(newParent, RBNode_getParent(node));
+	if (NULL == RBNode_getParent(node)) {
+		// If the old subtree was the root of the tree, set the new root as such
+		RBTree_setRoot(tree, newParent);
+	} else if (node == RBNode_getRightChild(RBNode_getParent(node))) {
+		// If the old subtree root was the right child of its parent, set the new subtree root as such
+		RBNode_setRightChild(RBNode_getParent(node), newParent);
+	} else {
+		// If the old subtree root was the left child of its parent, set the new subtree root as such
+		RBNode_setLeftChild(RBNode_getParent(node), newParent);
+	}
+	// Set the old subtree root as the right child of the new subtree root
+	RBNode_setRightChild(newParent, node);
+	RBNode_setParent(node, newParent);
+	if (tree->augmented) {
+		// The new subtree root takes over the whole subtree
+		RBNode_setSize(newParent, RBNode_getSize(node));
+		RBNode_setSize(node, RBNode_getSize(RBNode_getLeftChild(node)) + RBNode_getSize(RBNode_getRightChild(node)) + 1);
+	}
+}
+
+void RBTree_recolor(RBTree* tree, RBNode* node, RBNodeColor color) {
+	if (NULL == tree || NULL == node) {
+		return;
+	}
+	if (RBNode_getColor(node) != color) {
+		RBTREE_COUNT(tree, recolors, 1);
+	}
+	RBNode_setColor(node, color);
+}
+
+int RBTree_stats(RBTree* tree, RBTreeStats* stats) {
+	// Copies the counters and walks the tree for its depth and black-height histograms
+	if (NULL == tree || NULL == stats) {
+		return 1;
+	}
+	memset(stats, 0, sizeof(RBTreeStats));
+#ifdef RBTREE_STATS
+	stats->counters = tree->counters;
+#endif
+	RBNode* root = RBTree_getRoot(tree);
+	if (NULL == root) {
+		stats->blackHeights[0] = 1;
+		return 0;
+	}
+	RBNode* stack[RBTREE_MAX_HEIGHT + 1];
+	unsigned char depths[RBTREE_MAX_HEIGHT + 1];
+	unsigned char blacks[RBTREE_MAX_HEIGHT + 1];
+	int top = 0;
+	stack[0] = root;
+	depths[0] = 0;
+	blacks[0] = (BLACK == RBNode_getColor(root));
+	top = 1;
+	while (0 < top) {
+		top--;
+		RBNode* node = stack[top];
+		int depth = depths[top];
+		int black = blacks[top];
+		stats->depths[depth]++;
+		if (depth + 1 > stats->height) {
+			stats->height = depth + 1;
+		}
+		for (int dir = 0; dir < 2; dir++) {
+			RBNode* child = node->children[dir];
+			if (NULL == child) {
+				stats->blackHeights[black]++;
+			} else if (RBTREE_STATS_DEPTHS - 1 <= depth + 1 || RBTREE_MAX_HEIGHT < top + 1) {
+				return 1;  // Deeper than any red-black tree of this many nodes
+			} else {
+				stack[top] = child;
+				depths[top] = depth + 1;
+				blacks[top] = black + (BLACK == RBNode_getColor(child));
+				top++;
+			}
+		}
+	}
+	return 0;
+}
+
+void RBTree_addStats(RBTree* tree, RBTree* scratch) {
+	// Credits the rotations and recolors of a scratch tree to the tree it works for
+#ifdef RBTREE_STATS
+	RBTREE_COUNT(tree, leftRotations, scratch->counters.leftRotations);
+	RBTREE_COUNT(tree, rightRotations, scratch->counters.rightRotations);
+	RBTREE_COUNT(tree, recolors, scratch->counters.recolors);
+#else
+	(void)tree;
+	(void)scratch;
+#endif
+}
+
+void RBTree_resetStats(RBTree* tree) {
+	if (NULL == tree) {
+		return;
+	}
+#ifdef RBTREE_STATS
+	memset(&tree->counters, 0, sizeof(RBTreeCounters));
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START Par_RBTree FUNCTION DEFINITIONS
+//
+// The Par_ functions may be called from any number of threads at once. Each
+// call takes the tree's reader-writer lock for its whole duration, so every
+// call is atomic and they are linearizable: searches run in parallel with each
+// other and observe either all or none of a concurrent write. Mixing Par_
+// calls with the plain functions from other threads is not safe.
+// Par_RBTree_searchOptimistic takes no lock at all and is only as current as
+// the writers' sequence bumps, so it too must only run alongside Par_ writers.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int Par_RBTree_insert(RBTree* tree, void* key, void* value) {
+	if (NULL == tree) {
+		return 1;
+	}
+	pthread_rwlock_wrlock(&tree->lock);
+	Par_RBTree_beginWrite(tree);
+	int result = RBTree_insert(tree, key, value);
+	Par_RBTree_endWrite(tree);
+	pthread_rwlock_unlock(&tree->lock);
+	return result;
+}
+
+int Par_RBTree_upsert(RBTree* tree, void* key, void* value, Combiner combineFunction) {
+	if (NULL == tree) {
+		return 1;
+	}
+	pthread_rwlock_wrlock(&tree->lock);
+	Par_RBTree_beginWrite(tree);
+	int result = RBTree_upsert(tree, key, value, combineFunction);
+	Par_RBTree_endWrite(tree);
+	pthread_rwlock_unlock(&tree->lock);
+	return result;
+}
+
+int Par_RBTree_remove(RBTree* tree, void* key) {
+	if (NULL == tree) {
+		return 1;
+	}
+	pthread_rwlock_wrlock(&tree->lock);
+	Par_RBTree_beginWrite(tree);
+	int result = RBTree_remove(tree, key);
+	Par_RBTree_endWrite(tree);
+	pthread_rwlock_unlock(&tree->lock);
+	return result;
+}
+
+int Par_RBTree_intersect(RBTree* tree, RBTree* other, int threads) {
+	return Par_RBTree_combine(tree, other, 1, threads);
+}
+
+int Par_RBTree_difference(RBTree* tree, RBTree* other, int threads) {
+	return Par_RBTree_combine(tree, other, 0, threads);
+}
+
+int Par_RBTree_union(RBTree* tree, RBTree* other, int threads) {
+	if (0 != Par_RBTree_combine(tree, other, -1, threads)) {
+		return 1;
+	}
+	RBTree_delete(other);
+	return 0;
+}
+
+int Par_RBTree_combine(RBTree* tree, RBTree* other, int keepIfPresent, int threads) {
+	if (!RBTree_canCombine(tree, other, keepIfPresent)) {
+		return 1;
+	}
+	// Lock in address order so two threads combining the same pair cannot deadlock
+	RBTree* firstLocked = (tree < other) ? tree : other;
+	RBTree* secondLocked = (tree < other) ? other : tree;
+	if (firstLocked == tree || 0 > keepIfPresent) {
+		pthread_rwlock_wrlock(&firstLocked->lock);
+	} else {
+		pthread_rwlock_rdlock(&firstLocked->lock);
+	}
+	if (secondLocked == tree || 0 > keepIfPresent) {
+		pthread_rwlock_wrlock(&secondLocked->lock);
+	} else {
+		pthread_rwlock_rdlock(&secondLocked->lock);
+	}
+	// A union also empties other, so optimistic readers of either tree must retry
+	Par_RBTree_beginWrite(tree);
+	if (0 > keepIfPresent) {
+		Par_RBTree_beginWrite(other);
+	}
+	int result = RBTree_combine(tree, other, keepIfPresent, threads);
+	if (0 > keepIfPresent) {
+		Par_RBTree_endWrite(other);
+	}
+	Par_RBTree_endWrite(tree);
+	pthread_rwlock_unlock(&other->lock);
+	pthread_rwlock_unlock(&tree->lock);
+	return result;
+}
+
+void* Par_RBTree_search(RBTree* tree, void* key) {
+	if (NULL == tree) {
+		return NULL;
+	}
+	pthread_rwlock_rdlock(&tree->lock);
+	void* value = RBTree_search(tree, key);
+	pthread_rwlock_unlock(&tree->lock);
+	return value;
+}
+
+void* Par_RBTree_searchOptimistic(RBTree* tree, void* key) {
+	// Searches without the lock and keeps the result only if no Par_ writer ran meanwhile.
+	// Removed nodes stay on the free lists, so a stale path never reaches freed memory,
+	// but a key destructor could free a key the walk still compares against.
+	if (NULL == tree || NULL == key || NULL != tree->keyDestructor) {
+		return Par_RBTree_search(tree, key);
+	}
+	for (int attempt = 0; attempt < RBTREE_OPTIMISTIC_RETRIES; attempt++) {
+		unsigned int sequence = atomic_load_explicit(&tree->sequence, memory_order_acquire);
+		if (sequence & 1) {
+			continue;
+		}
+		void* value = NULL;
+		RBNode* currNode = RBTREE_LOAD(tree->root);
+		// A walk racing a rotation may wander, the height bound stops it
+		for (int depth = 0; NULL != currNode && depth < RBTREE_MAX_HEIGHT; depth++) {
+			int order = tree->keyCompareFunction(RBTREE_LOAD(currNode->key), key);
+			if (0 == order) {
+				value = RBTREE_LOAD(currNode->value);
+				break;
+			}
+			currNode = RBTREE_LOAD(currNode->children[0 < order]);
+		}
+		atomic_thread_fence(memory_order_acquire);
+		if (sequence == atomic_load_explicit(&tree->sequence, memory_order_relaxed)) {
+			return value;
+		}
+	}
+	return Par_RBTree_search(tree, key);
+}
+
+void Par_RBTree_beginWrite(RBTree* tree) {
+	// Called with the write lock held, the odd sequence turns optimistic readers away
+	unsigned int sequence = atomic_load_explicit(&tree->sequence, memory_order_relaxed);
+	atomic_store_explicit(&tree->sequence, sequence + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+}
+
+void Par_RBTree_endWrite(RBTree* tree) {
+	unsigned int sequence = atomic_load_explicit(&tree->sequence, memory_order_relaxed);
+	atomic_store_explicit(&tree->sequence, sequence + 1, memory_order_release);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTreeIterator FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBTreeIterator* RBTreeIterator_create(RBTree* tree) {
+	RBTreeIterator* newIter = malloc(sizeof(RBTreeIterator));
+	if (newIter == NULL) {
+		return NULL;
+	}
+	RBTreeIterator_init(newIter, tree);
+	return newIter;
+}
+
+RBTreeIterator* RBTreeIterator_createRange(RBTree* tree, void* lo, void* hi) {
+	RBTreeIterator* newIter = malloc(sizeof(RBTreeIterator));
+	if (newIter == NULL) {
+		return NULL;
+	}
+	RBTreeIterator_initRange(newIter, tree, lo, hi);
+	return newIter;
+}
+
+void RBTreeIterator_init(RBTreeIterator* iter, RBTree* tree) {
+	// Sets up a caller-owned iterator, such as one on the stack, which needs no delete
+	if (NULL == iter) {
+		return;
+	}
+	iter->tree = tree;
+	iter->currNode = NULL;
+	iter->nextNode = RBTree_getRoot(tree);
+	iter->endNode = NULL;
+	while (NULL != RBNode_getLeftChild(iter->nextNode)) {
+		iter->nextNode = RBNode_getLeftChild(iter->nextNode);
+	}
+}
+
+void RBTreeIterator_initRange(RBTreeIterator* iter, RBTree* tree, void* lo, void* hi) {
+	// Iterates the keys in [lo, hi), a NULL bound leaves that side open
+	RBTreeIterator_init(iter, tree);
+	if (NULL == iter) {
+		return;
+	}
+	if (NULL != lo) {
+		iter->nextNode = RBTree_lowerBound(tree, lo);
+	}
+	if (NULL != hi) {
+		iter->endNode = RBTree_lowerBound(tree, hi);
+		if (iter->nextNode == iter->endNode || (NULL != lo && 0 <= RBTree_compareKeys(tree, hi, lo))) {
+			iter->nextNode = NULL;
+		}
+	}
+}
+
+int RBTreeIterator_split(RBTree* tree, RBTreeIterator* iters, int count) {
+	// Fills count iterators over disjoint, contiguous and ascending ranges that together cover the tree
+	if (NULL == tree || NULL == iters || 0 >= count) {
+		return 1;
+	}
+	RBNode** bounds = malloc(((size_t)count + 1) * sizeof(RBNode*));
+	if (NULL == bounds) {
+		return 1;
+	}
+	bounds[count] = NULL;
+	if (tree->augmented) {
+		// Subtree sizes give exact, equal ranges
+		int size = RBNode_getSize(tree->root);
+		for (int i = 0; i < count; i++) {
+			bounds[i] = RBTree_selectNode(tree, (int)((long)size * i / count));
+		}
+	} else {
+		// Otherwise cut at the nodes of the top levels, which split the tree roughly evenly
+		int depth = 1;
+		while ((1 << depth) < 4 * count && depth < 24) {
+			depth++;
+		}
+		RBNode** top = malloc(((size_t)1 << depth) * sizeof(RBNode*));
+		if (NULL == top) {
+			free(bounds);
+			return 1;
+		}
+		int topCount = RBTreeIterator_collectTop(tree->root, depth, top, 0);
+		for (int i = 0; i < count; i++) {
+			bounds[i] = (0 == i || 0 == topCount) ? NULL : top[(long)topCount * i / count];
+		}
+		free(top);
+		// The first range starts at the minimum
+		RBTreeIterator_init(&iters[0], tree);
+		bounds[0] = iters[0].nextNode;
+	}
+	for (int i = 0; i < count; i++) {
+		RBTreeIterator_init(&iters[i], tree);
+		iters[i].nextNode = (bounds[i] == bounds[i + 1]) ? NULL : bounds[i];
+		iters[i].endNode = bounds[i + 1];
+	}
+	free(bounds);
+	return 0;
+}
+
+int RBTreeIterator_collectTop(RBNode* node, int depth, RBNode** nodes, int count) {
+	// Appends the nodes less than depth levels down, in order
+	if (NULL == node || 0 == depth) {
+		return count;
+	}
+	count = RBTreeIterator_collectTop(RBNode_getLeftChild(node), depth - 1, nodes, count);
+	nodes[count++] = node;
+	return RBTreeIterator_collectTop(RBNode_getRightChild(node), depth - 1, nodes, count);
+}
+
+void* RBTreeIterator_getKey(RBTreeIterator* iter) {
+	if (NULL == iter) {
+		return NULL;
+	}
+	return RBNode_getKey(iter->currNode);
+}
+
+void* RBTreeIterator_getValue(RBTreeIterator* iter) {
+	if (NULL == iter) {
+		return NULL;
+	}
+	return RBNode_getValue(iter->currNode);
+}
+
+int RBTreeIterator_hasNext(RBTreeIterator* iter) {
+	if (NULL == iter) {
+		return 0;
+	}
+	return (NULL == iter->nextNode) ? 0 : 1;
+}
+
+void RBTreeIterator_getNext(RBTreeIterator* iter) {
+	iter->currNode = iter->nextNode;
+	if (NULL == iter->currNode) {
+		iter->nextNode = NULL;
+		return;
+	}
+
+	if (NULL != RBNode_getRightChild(iter->currNode)) {
+		iter->nextNode = RBNode_getRightChild(iter->currNode);
+		while (NULL != RBNode_getLeftChild(iter->nextNode)) {
+			iter->nextNode = RBNode_getLeftChild(iter->nextNode);
+		}
+	} else {
+		RBNode* n = iter->currNode;
+		RBNode* p = RBNode_getParent(n);
+		while (NULL != p && n == RBNode_getRightChild(p)) {
+			n = p;
+			p = RBNode_getParent(p);
+		}
+		iter->nextNode = p;
+	}
+	if (iter->nextNode == iter->endNode) {
+		iter->nextNode = NULL;
+	}
+}
+
+void RBTreeIterator_delete(RBTreeIterator* iter) {
+	if (NULL != iter) {
+		free(iter);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBShardedTree FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBShardedTree* RBShardedTree_create(Comparator keyCompareFunction, int shardCount) {
+	// Routes every key to shard 0 until createHashed or createRanged sets the routing
+	if (0 >= shardCount) {
+		return NULL;
+	}
+	RBShardedTree* newTree = malloc(sizeof(RBShardedTree));
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->shards = calloc((size_t)shardCount, sizeof(RBTree*));
+	newTree->shardCount = shardCount;
+	newTree->keyCompareFunction = keyCompareFunction;
+	newTree->keyHashFunction = NULL;
+	newTree->splitters = NULL;
+	if (NULL == newTree->shards) {
+		RBShardedTree_delete(newTree);
+		return NULL;
+	}
+	for (int i = 0; i < shardCount; i++) {
+		newTree->shards[i] = RBTree_createWithArena(keyCompareFunction, 0);
+		if (NULL == newTree->shards[i]) {
+			RBShardedTree_delete(newTree);
+			return NULL;
+		}
+	}
+	return newTree;
+}
+
+RBShardedTree* RBShardedTree_createHashed(Comparator keyCompareFunction, KeyHash keyHashFunction, int shardCount) {
+	if (NULL == keyHashFunction) {
+		return NULL;
+	}
+	RBShardedTree* newTree = RBShardedTree_create(keyCompareFunction, shardCount);
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->keyHashFunction = keyHashFunction;
+	return newTree;
+}
+
+RBShardedTree* RBShardedTree_createRanged(Comparator keyCompareFunction, void** splitters, int shardCount) {
+	if (NULL == splitters && 1 < shardCount) {
+		return NULL;
+	}
+	// Splitters must ascend so that the shards are ordered
+	for (int i = 1; i < shardCount - 1; i++) {
+		if (0 > keyCompareFunction(splitters[i - 1], splitters[i])) {
+			return NULL;
+		}
+	}
+	RBShardedTree* newTree = RBShardedTree_create(keyCompareFunction, shardCount);
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->splitters = malloc((size_t)shardCount * sizeof(void*));
+	if (NULL == newTree->splitters) {
+		RBShardedTree_delete(newTree);
+		return NULL;
+	}
+	for (int i = 0; i < shardCount - 1; i++) {
+		newTree->splitters[i] = splitters[i];
+	}
+	return newTree;
+}
+
+void RBShardedTree_delete(RBShardedTree* tree) {
+	if (NULL == tree) {
+		return;
+	}
+	if (NULL != tree->shards) {
+		for (int i = 0; i < tree->shardCount; i++) {
+			RBTree_delete(tree->shards[i]);
+		}
+		free(tree->shards);
+	}
+	free(tree->splitters);
+	free(tree);
+}
+
+int RBShardedTree_getShardIndex(RBShardedTree* tree, void* key) {
+	if (NULL == tree || NULL == key) {
+		return -1;
+	}
+	if (NULL != tree->keyHashFunction) {
+		return (int)(tree->keyHashFunction(key) % (unsigned long)tree->shardCount);
+	}
+	if (NULL == tree->splitters) {
+		return 0;
+	}
+	// Shard i holds keys in [splitters[i - 1], splitters[i]), find the first splitter above the key
+	int lo = 0;
+	int hi = tree->shardCount - 1;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (0 < tree->keyCompareFunction(key, tree->splitters[mid])) {
+			hi = mid;
+		} else {
+			lo = mid + 1;
+		}
+	}
+	return lo;
+}
+
+RBTree* RBShardedTree_getShard(RBShardedTree* tree, int index) {
+	if (NULL == tree || 0 > index || index >= tree->shardCount) {
+		return NULL;
+	}
+	return tree->shards[index];
+}
+
+int RBShardedTree_insert(RBShardedTree* tree, void* key, void* value) {
+	RBTree* shard = RBShardedTree_getShard(tree, RBShardedTree_getShardIndex(tree, key));
+	if (NULL == shard) {
+		return 1;
+	}
+	return Par_RBTree_insert(shard, key, value);
+}
+
+int RBShardedTree_upsert(RBShardedTree* tree, void* key, void* value, Combiner combineFunction) {
+	RBTree* shard = RBShardedTree_getShard(tree, RBShardedTree_getShardIndex(tree, key));
+	if (NULL == shard) {
+		return 1;
+	}
+	return Par_RBTree_upsert(shard, key, value, combineFunction);
+}
+
+void* RBShardedTree_search(RBShardedTree* tree, void* key) {
+	RBTree* shard = RBShardedTree_getShard(tree, RBShardedTree_getShardIndex(tree, key));
+	if (NULL == shard) {
+		return NULL;
+	}
+	return Par_RBTree_search(shard, key);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBShardedTreeIterator FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBShardedTreeIterator* RBShardedTreeIterator_create(RBShardedTree* tree) {
+	if (NULL == tree) {
+		return NULL;
+	}
+	RBShardedTreeIterator* newIter = malloc(sizeof(RBShardedTreeIterator));
+	if (NULL == newIter) {
+		return NULL;
+	}
+	newIter->tree = tree;
+	newIter->currShard = -1;
+	newIter->shardIters = malloc((size_t)tree->shardCount * sizeof(RBTreeIterator));
+	if (NULL == newIter->shardIters) {
+		RBShardedTreeIterator_delete(newIter);
+		return NULL;
+	}
+	for (int i = 0; i < tree->shardCount; i++) {
+		RBTreeIterator_init(&newIter->shardIters[i], tree->shards[i]);
+	}
+	return newIter;
+}
+
+void RBShardedTreeIterator_delete(RBShardedTreeIterator* iter) {
+	if (NULL == iter) {
+		return;
+	}
+	free(iter->shardIters);
+	free(iter);
+}
+
+void* RBShardedTreeIterator_getKey(RBShardedTreeIterator* iter) {
+	if (NULL == iter || 0 > iter->currShard) {
+		return NULL;
+	}
+	return RBTreeIterator_getKey(&iter->shardIters[iter->currShard]);
+}
+
+void* RBShardedTreeIterator_getValue(RBShardedTreeIterator* iter) {
+	if (NULL == iter || 0 > iter->currShard) {
+		return NULL;
+	}
+	return RBTreeIterator_getValue(&iter->shardIters[iter->currShard]);
+}
+
+void RBShardedTreeIterator_getNext(RBShardedTreeIterator* iter) {
+	if (NULL == iter) {
+		return;
+	}
+	RBShardedTree* tree = iter->tree;
+	int nextShard = -1;
+	if (NULL == tree->keyHashFunction) {
+		// Range partitioned shards are already in order, walk them one after another
+		nextShard = (0 > iter->currShard) ? 0 : iter->currShard;
+		while (nextShard < tree->shardCount && !RBTreeIterator_hasNext(&iter->shardIters[nextShard])) {
+			nextShard++;
+		}
+		if (nextShard == tree->shardCount) {
+			nextShard = -1;
+		}
+	} else {
+		// Hashed shards interleave, merge them by taking the smallest pending key
+		void* nextKey = NULL;
+		for (int i = 0; i < tree->shardCount; i++) {
+			RBNode* pending = iter->shardIters[i].nextNode;
+			if (NULL != pending && (NULL == nextKey || 0 < tree->keyCompareFunction(RBNode_getKey(pending), nextKey))) {
+				nextKey = RBNode_getKey(pending);
+				nextShard = i;
+			}
+		}
+	}
+	iter->currShard = nextShard;
+	if (0 <= nextShard) {
+		RBTreeIterator_getNext(&iter->shardIters[nextShard]);
+	}
+}
+
+int RBShardedTreeIterator_hasNext(RBShardedTreeIterator* iter) {
 	if (NULL == iter) {
 		return 0;
 	}
-	return (NULL == iter->nextNode) ? 0 : 1;
+	int i = (0 > iter->currShard || NULL != iter->tree->keyHashFunction) ? 0 : iter->currShard;
+	for (; i < iter->tree->shardCount; i++) {
+		if (RBTreeIterator_hasNext(&iter->shardIters[i])) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTreeImage FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// A saved tree is the magic, a uint64_t entry count, a table of uint64_t record offsets and
+// then the records in key order. Each record is a uint32_t key length, a uint32_t value length,
+// the key bytes and the value bytes, each padded to eight bytes so they can be read in place.
+
+int RBTree_save(RBTree* tree, const char* path, Serializer keySerializer, Serializer valueSerializer) {
+	if (NULL == tree || NULL == path || NULL == keySerializer || NULL == valueSerializer) {
+		return 1;
+	}
+	static const unsigned char padding[8] = { 0 };
+	int count = RBTree_size(tree);
+	uint64_t* offsets = malloc(((size_t)count + 1) * sizeof(uint64_t));
+	size_t keyCapacity = 64;
+	size_t valueCapacity = 64;
+	unsigned char* keyBuffer = malloc(keyCapacity);
+	unsigned char* valueBuffer = malloc(valueCapacity);
+	FILE* file = fopen(path, "wb");
+	int failed = (NULL == offsets || NULL == keyBuffer || NULL == valueBuffer || NULL == file);
+	uint64_t header[2] = { 0, (uint64_t)count };
+	memcpy(header, RBTREE_IMAGE_MAGIC, sizeof(uint64_t));
+	uint64_t position = RBTREE_IMAGE_HEADER + (uint64_t)count * sizeof(uint64_t);
+	// The offset table is written last, once every record has been placed
+	failed = failed || 1 != fwrite(header, sizeof(header), 1, file) || 0 != fseek(file, (long)position, SEEK_SET);
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	for (int i = 0; !failed && RBTreeIterator_hasNext(&iter); i++) {
+		RBTreeIterator_getNext(&iter);
+		size_t keyLength = RBTree_serializeItem(keySerializer, RBTreeIterator_getKey(&iter), &keyBuffer, &keyCapacity);
+		size_t valueLength = RBTree_serializeItem(valueSerializer, RBTreeIterator_getValue(&iter), &valueBuffer, &valueCapacity);
+		if (SIZE_MAX == keyLength || SIZE_MAX == valueLength || UINT32_MAX < keyLength || UINT32_MAX < valueLength) {
+			failed = 1;
+			break;
+		}
+		uint32_t lengths[2] = { (uint32_t)keyLength, (uint32_t)valueLength };
+		size_t keyPadding = (8 - keyLength % 8) % 8;
+		size_t valuePadding = (8 - valueLength % 8) % 8;
+		offsets[i] = position;
+		failed = 1 != fwrite(lengths, sizeof(lengths), 1, file)
+			|| keyLength != fwrite(keyBuffer, 1, keyLength, file)
+			|| keyPadding != fwrite(padding, 1, keyPadding, file)
+			|| valueLength != fwrite(valueBuffer, 1, valueLength, file)
+			|| valuePadding != fwrite(padding, 1, valuePadding, file);
+		position += sizeof(lengths) + keyLength + keyPadding + valueLength + valuePadding;
+	}
+	failed = failed || 0 != fseek(file, RBTREE_IMAGE_HEADER, SEEK_SET)
+		|| (size_t)count != fwrite(offsets, sizeof(uint64_t), (size_t)count, file);
+	if (NULL != file && 0 != fclose(file)) {
+		failed = 1;
+	}
+	free(offsets);
+	free(keyBuffer);
+	free(valueBuffer);
+	return failed;
+}
+
+size_t RBTree_serializeItem(Serializer serializer, void* item, unsigned char** buffer, size_t* capacity) {
+	// Grows the buffer and asks again when the item does not fit, SIZE_MAX when it cannot
+	size_t length = serializer(item, *buffer, *capacity);
+	if (length > *capacity) {
+		unsigned char* newBuffer = realloc(*buffer, length);
+		if (NULL == newBuffer) {
+			return SIZE_MAX;
+		}
+		*buffer = newBuffer;
+		*capacity = length;
+		length = serializer(item, *buffer, *capacity);
+	}
+	return (length > *capacity) ? SIZE_MAX : length;
+}
+
+RBTree* RBTree_load(const char* path, Comparator keyCompareFunction, Deserializer keyDeserializer,
+	Deserializer valueDeserializer, Destructor keyDestructor, Destructor valueDestructor) {
+	// Keys and values are copied out, so the file is unmapped before returning
+	if (NULL == keyDeserializer || NULL == valueDeserializer) {
+		return NULL;
+	}
+	RBTreeImage* image = RBTreeImage_open(path, keyCompareFunction);
+	RBTree* newTree = RBTree_loadImage(image, keyDeserializer, valueDeserializer, keyDestructor, valueDestructor);
+	RBTreeImage_close(image);
+	return newTree;
+}
+
+RBTree* RBTree_loadImage(RBTreeImage* image, Deserializer keyDeserializer, Deserializer valueDeserializer,
+	Destructor keyDestructor, Destructor valueDestructor) {
+	// A NULL deserializer leaves that field pointing into the image, which must then outlive the tree
+	if (NULL == image) {
+		return NULL;
+	}
+	void** keys = malloc(((size_t)image->count + 1) * sizeof(void*));
+	void** values = malloc(((size_t)image->count + 1) * sizeof(void*));
+	int loaded = 0;
+	while (NULL != keys && NULL != values && loaded < image->count) {
+		size_t keyLength;
+		size_t valueLength;
+		void* key = RBTreeImage_getKey(image, loaded, &keyLength);
+		void* value = RBTreeImage_getValue(image, loaded, &valueLength);
+		if (NULL == key || NULL == value) {
+			break;
+		}
+		keys[loaded] = (NULL == keyDeserializer) ? key : keyDeserializer(key, keyLength);
+		values[loaded] = (NULL == valueDeserializer) ? value : valueDeserializer(value, valueLength);
+		if (NULL == keys[loaded] || NULL == values[loaded]) {
+			// Free whichever half of this entry was built, the earlier entries are freed below
+			if (NULL != keys[loaded] && NULL != keyDestructor) {
+				keyDestructor(keys[loaded]);
+			}
+			if (NULL != values[loaded] && NULL != valueDestructor) {
+				valueDestructor(values[loaded]);
+			}
+			break;
+		}
+		loaded++;
+	}
+	RBTree* newTree = NULL;
+	if (loaded == image->count) {
+		newTree = RBTree_buildFromSorted(keys, values, loaded, image->keyCompareFunction);
+	}
+	if (NULL == newTree) {
+		for (int i = 0; NULL != keys && NULL != values && i < loaded; i++) {
+			if (NULL != keyDestructor) {
+				keyDestructor(keys[i]);
+			}
+			if (NULL != valueDestructor) {
+				valueDestructor(values[i]);
+			}
+		}
+	} else {
+		RBTree_setDestructors(newTree, keyDestructor, valueDestructor);
+	}
+	free(keys);
+	free(values);
+	return newTree;
+}
+
+RBTreeImage* RBTreeImage_open(const char* path, Comparator keyCompareFunction) {
+	if (NULL == path || NULL == keyCompareFunction) {
+		return NULL;
+	}
+	int fd = open(path, O_RDONLY);
+	if (0 > fd) {
+		return NULL;
+	}
+	struct stat status;
+	if (0 != fstat(fd, &status) || RBTREE_IMAGE_HEADER > status.st_size) {
+		close(fd);
+		return NULL;
+	}
+	void* map = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == map) {
+		return NULL;
+	}
+	RBTreeImage* newImage = malloc(sizeof(RBTreeImage));
+	uint64_t count = ((uint64_t*)map)[1];
+	uint64_t maxCount = ((uint64_t)status.st_size - RBTREE_IMAGE_HEADER) / sizeof(uint64_t);
+	if (NULL == newImage || 0 != memcmp(map, RBTREE_IMAGE_MAGIC, sizeof(uint64_t)) || count > maxCount || INT32_MAX < count) {
+		munmap(map, (size_t)status.st_size);
+		free(newImage);
+		return NULL;
+	}
+	newImage->map = map;
+	newImage->length = (size_t)status.st_size;
+	newImage->count = (int)count;
+	newImage->offsets = (uint64_t*)(newImage->map + RBTREE_IMAGE_HEADER);
+	newImage->keyCompareFunction = keyCompareFunction;
+	return newImage;
+}
+
+void RBTreeImage_close(RBTreeImage* image) {
+	if (NULL != image) {
+		munmap(image->map, image->length);
+		free(image);
+	}
+}
+
+int RBTreeImage_getCount(RBTreeImage* image) {
+	if (NULL == image) {
+		return 0;
+	}
+	return image->count;
+}
+
+void* RBTreeImage_getKey(RBTreeImage* image, int index, size_t* length) {
+	// Records are checked against the mapping as they are read, so a damaged file gives NULL
+	if (NULL == image || 0 > index || index >= image->count) {
+		return NULL;
+	}
+	uint64_t offset = image->offsets[index];
+	if (0 != offset % 8 || offset > image->length - 2 * sizeof(uint32_t)) {
+		return NULL;
+	}
+	uint32_t keyLength = ((uint32_t*)(image->map + offset))[0];
+	if (keyLength > image->length - offset - 2 * sizeof(uint32_t)) {
+		return NULL;
+	}
+	if (NULL != length) {
+		*length = keyLength;
+	}
+	return image->map + offset + 2 * sizeof(uint32_t);
+}
+
+void* RBTreeImage_getValue(RBTreeImage* image, int index, size_t* length) {
+	size_t keyLength;
+	unsigned char* key = RBTreeImage_getKey(image, index, &keyLength);
+	if (NULL == key) {
+		return NULL;
+	}
+	uint64_t offset = (uint64_t)(key - image->map) + keyLength + (8 - keyLength % 8) % 8;
+	uint32_t valueLength = ((uint32_t*)key)[-1];
+	if (offset > image->length || valueLength > image->length - offset) {
+		return NULL;
+	}
+	if (NULL != length) {
+		*length = valueLength;
+	}
+	return image->map + offset;
+}
+
+int RBTreeImage_lowerBound(RBTreeImage* image, void* key) {
+	// Index of the first entry whose key is not less than key, the count when there is none
+	if (NULL == image || NULL == key) {
+		return 0;
+	}
+	int lo = 0;
+	int hi = image->count;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		void* midKey = RBTreeImage_getKey(image, mid, NULL);
+		if (NULL == midKey) {
+			return image->count;
+		}
+		if (0 < image->keyCompareFunction(midKey, key)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+void* RBTreeImage_search(RBTreeImage* image, void* key) {
+	// Reads the value in place, it stays valid until the image is closed
+	int index = RBTreeImage_lowerBound(image, key);
+	void* foundKey = RBTreeImage_getKey(image, index, NULL);
+	if (NULL == foundKey || 0 != image->keyCompareFunction(foundKey, key)) {
+		return NULL;
+	}
+	return RBTreeImage_getValue(image, index, NULL);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBPersistentTree FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// Writers never change a node that an earlier version can reach. Each write copies the nodes
+// it touches, stamps the copies with its version so it may keep changing them in place, and
+// publishes the new root when it is done. Nodes are freed when the last reference goes.
+
+RBPersistentTree* RBPersistentTree_create(Comparator keyCompareFunction) {
+	RBPersistentTree* newTree = malloc(sizeof(RBPersistentTree));
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->root = NULL;
+	newTree->keyCompareFunction = keyCompareFunction;
+	newTree->size = 0;
+	newTree->version = 0;
+	pthread_mutex_init(&newTree->writeLock, NULL);
+	pthread_mutex_init(&newTree->rootLock, NULL);
+	return newTree;
+}
+
+void RBPersistentTree_delete(RBPersistentTree* tree) {
+	// Snapshots taken earlier keep their nodes alive until they are released
+	if (NULL != tree) {
+		RBPersistentNode_release(tree->root);
+		pthread_mutex_destroy(&tree->writeLock);
+		pthread_mutex_destroy(&tree->rootLock);
+		free(tree);
+	}
+}
+
+int RBPersistentTree_insert(RBPersistentTree* tree, void* key, void* value) {
+	if (NULL == tree || NULL == key || NULL == value) {
+		return 1;
+	}
+	pthread_mutex_lock(&tree->writeLock);
+	tree->version++;
+	RBPersistentNode* path[RBTREE_MAX_HEIGHT];
+	int dirs[RBTREE_MAX_HEIGHT];
+	int depth = 0;
+	// Copy the search path, equal keys go right as in RBTree_insert
+	RBPersistentNode* newRoot = RBPersistentNode_retain(tree->root);
+	RBPersistentNode** link = &newRoot;
+	while (NULL != *link) {
+		RBPersistentNode* currNode = RBPersistentNode_makeMutable(tree, link);
+		if (NULL == currNode) {
+			RBPersistentNode_release(newRoot);
+			pthread_mutex_unlock(&tree->writeLock);
+			return 1;
+		}
+		path[depth] = currNode;
+		dirs[depth] = (0 <= tree->keyCompareFunction(currNode->key, key));
+		link = &currNode->children[dirs[depth]];
+		depth++;
+	}
+	RBPersistentNode* newNode = malloc(sizeof(RBPersistentNode));
+	if (NULL == newNode) {
+		RBPersistentNode_release(newRoot);
+		pthread_mutex_unlock(&tree->writeLock);
+		return 1;
+	}
+	atomic_init(&newNode->refCount, 1);
+	newNode->color = RED;
+	newNode->version = tree->version;
+	newNode->children[0] = NULL;
+	newNode->children[1] = NULL;
+	newNode->key = key;
+	newNode->value = value;
+	*link = newNode;
+	path[depth] = newNode;
+	// Repair upward along the copied path, which stands in for parent pointers
+	int i = depth;
+	while (2 <= i && RED == path[i - 1]->color) {
+		RBPersistentNode* parent = path[i - 1];
+		RBPersistentNode* grandparent = path[i - 2];
+		int side = dirs[i - 2];
+		if (RBPersistentNode_isRed(grandparent->children[1 - side])) {
+			RBPersistentNode* uncle = RBPersistentNode_makeMutable(tree, &grandparent->children[1 - side]);
+			if (NULL == uncle) {
+				// Nothing shared has changed, so dropping the new version leaves the tree as it was
+				RBPersistentNode_release(newRoot);
+				pthread_mutex_unlock(&tree->writeLock);
+				return 1;
+			}
+			parent->color = BLACK;
+			uncle->color = BLACK;
+			grandparent->color = RED;
+			i -= 2;
+			continue;
+		}
+		if (dirs[i - 1] != side) {
+			grandparent->children[side] = RBPersistentNode_rotate(parent, side);
+			parent = path[i];
+		}
+		RBPersistentNode** grandparentLink = (2 == i) ? &newRoot : &path[i - 3]->children[dirs[i - 3]];
+		*grandparentLink = RBPersistentNode_rotate(grandparent, 1 - side);
+		parent->color = BLACK;
+		grandparent->color = RED;
+		break;
+	}
+	newRoot->color = BLACK;
+	RBPersistentTree_publish(tree, newRoot, tree->size + 1);
+	pthread_mutex_unlock(&tree->writeLock);
+	return 0;
+}
+
+int RBPersistentTree_remove(RBPersistentTree* tree, void* key) {
+	if (NULL == tree || NULL == key) {
+		return 1;
+	}
+	pthread_mutex_lock(&tree->writeLock);
+	// Look first, so a missing key copies nothing
+	RBPersistentNode* currNode = tree->root;
+	while (NULL != currNode && 0 != tree->keyCompareFunction(currNode->key, key)) {
+		currNode = currNode->children[0 <= tree->keyCompareFunction(currNode->key, key)];
+	}
+	if (NULL == currNode) {
+		pthread_mutex_unlock(&tree->writeLock);
+		return 1;
+	}
+	tree->version++;
+	RBPersistentNode* path[RBTREE_MAX_HEIGHT];
+	int dirs[RBTREE_MAX_HEIGHT];
+	int depth = 0;
+	RBPersistentNode* newRoot = RBPersistentNode_retain(tree->root);
+	RBPersistentNode** link = &newRoot;
+	RBPersistentNode* found = NULL;
+	// Copy down to the key, then on to its successor when it has two children
+	while (NULL != *link) {
+		currNode = RBPersistentNode_makeMutable(tree, link);
+		if (NULL == currNode) {
+			RBPersistentNode_release(newRoot);
+			pthread_mutex_unlock(&tree->writeLock);
+			return 1;
+		}
+		int order = (NULL == found) ? tree->keyCompareFunction(currNode->key, key) : 1;
+		if (0 == order) {
+			found = currNode;
+			if (NULL == currNode->children[0] || NULL == currNode->children[1]) {
+				break;
+			}
+			path[depth] = currNode;
+			dirs[depth] = 1;
+		} else if (NULL != found && NULL == currNode->children[0]) {
+			break;
+		} else {
+			path[depth] = currNode;
+			dirs[depth] = (NULL != found) ? 0 : (0 < order);
+		}
+		link = &currNode->children[dirs[depth]];
+		depth++;
+	}
+	// The successor gives its entry to the found node and is unlinked in its place
+	RBPersistentNode* removed = *link;
+	found->key = removed->key;
+	found->value = removed->value;
+	RBPersistentNode* child = removed->children[NULL == removed->children[0]];
+	*link = child;
+	removed->children[0] = NULL;
+	removed->children[1] = NULL;
+	RBNodeColor removedColor = removed->color;
+	RBPersistentNode_release(removed);
+	int failed = 0;
+	if (BLACK == removedColor) {
+		// The path is one black short below link, push the deficit up until it can be absorbed
+		int k = depth - 1;
+		while (0 <= k && !RBPersistentNode_isRed(*link)) {
+			RBPersistentNode* parent = path[k];
+			int dir = dirs[k];
+			RBPersistentNode** parentLink = (0 == k) ? &newRoot : &path[k - 1]->children[dirs[k - 1]];
+			RBPersistentNode* sibling = RBPersistentNode_makeMutable(tree, &parent->children[1 - dir]);
+			if (NULL == sibling) {
+				failed = 1;
+				break;
+			}
+			if (RED == sibling->color) {
+				// Make the sibling black by rotating it above the parent
+				sibling->color = BLACK;
+				parent->color = RED;
+				*parentLink = RBPersistentNode_rotate(parent, dir);
+				path[k] = sibling;
+				path[k + 1] = parent;
+				dirs[k + 1] = dir;
+				k++;
+				parentLink = &sibling->children[dir];
+				sibling = RBPersistentNode_makeMutable(tree, &parent->children[1 - dir]);
+				if (NULL == sibling) {
+					failed = 1;
+					break;
+				}
+			}
+			if (!RBPersistentNode_isRed(sibling->children[0]) && !RBPersistentNode_isRed(sibling->children[1])) {
+				sibling->color = RED;
+				link = parentLink;
+				k--;
+				continue;
+			}
+			if (!RBPersistentNode_isRed(sibling->children[1 - dir])) {
+				RBPersistentNode* nephew = RBPersistentNode_makeMutable(tree, &sibling->children[dir]);
+				if (NULL == nephew) {
+					failed = 1;
+					break;
+				}
+				nephew->color = BLACK;
+				sibling->color = RED;
+				parent->children[1 - dir] = RBPersistentNode_rotate(sibling, 1 - dir);
+				sibling = nephew;
+			}
+			RBPersistentNode* farNephew = RBPersistentNode_makeMutable(tree, &sibling->children[1 - dir]);
+			if (NULL == farNephew) {
+				failed = 1;
+				break;
+			}
+			sibling->color = parent->color;
+			parent->color = BLACK;
+			farNephew->color = BLACK;
+			*parentLink = RBPersistentNode_rotate(parent, dir);
+			link = &newRoot;
+			break;
+		}
+		// A red node that took the deficit turns black
+		if (!failed && RBPersistentNode_isRed(*link)) {
+			RBPersistentNode* blackened = RBPersistentNode_makeMutable(tree, link);
+			failed = (NULL == blackened);
+			if (!failed) {
+				blackened->color = BLACK;
+			}
+		}
+	}
+	if (!failed && RBPersistentNode_isRed(newRoot)) {
+		RBPersistentNode* blackened = RBPersistentNode_makeMutable(tree, &newRoot);
+		failed = (NULL == blackened);
+		if (!failed) {
+			blackened->color = BLACK;
+		}
+	}
+	if (failed) {
+		// Nothing shared has changed, so dropping the new version leaves the tree as it was
+		RBPersistentNode_release(newRoot);
+		pthread_mutex_unlock(&tree->writeLock);
+		return 1;
+	}
+	RBPersistentTree_publish(tree, newRoot, tree->size - 1);
+	pthread_mutex_unlock(&tree->writeLock);
+	return 0;
+}
+
+RBSnapshot* RBPersistentTree_snapshot(RBPersistentTree* tree) {
+	// O(1), the snapshot shares every node with the tree and never changes
+	if (NULL == tree) {
+		return NULL;
+	}
+	RBSnapshot* newSnapshot = malloc(sizeof(RBSnapshot));
+	if (NULL == newSnapshot) {
+		return NULL;
+	}
+	newSnapshot->keyCompareFunction = tree->keyCompareFunction;
+	pthread_mutex_lock(&tree->rootLock);
+	newSnapshot->root = RBPersistentNode_retain(tree->root);
+	newSnapshot->size = tree->size;
+	pthread_mutex_unlock(&tree->rootLock);
+	return newSnapshot;
+}
+
+void RBPersistentTree_publish(RBPersistentTree* tree, RBPersistentNode* newRoot, int size) {
+	// Swaps in the new version, the old one is freed here unless a snapshot still holds it
+	pthread_mutex_lock(&tree->rootLock);
+	RBPersistentNode* oldRoot = tree->root;
+	tree->root = newRoot;
+	tree->size = size;
+	pthread_mutex_unlock(&tree->rootLock);
+	RBPersistentNode_release(oldRoot);
+}
+
+RBPersistentNode* RBPersistentNode_copy(RBPersistentTree* tree, RBPersistentNode* node) {
+	RBPersistentNode* newNode = malloc(sizeof(RBPersistentNode));
+	if (NULL == newNode) {
+		return NULL;
+	}
+	atomic_init(&newNode->refCount, 1);
+	newNode->color = node->color;
+	newNode->version = tree->version;
+	newNode->children[0] = RBPersistentNode_retain(node->children[0]);
+	newNode->children[1] = RBPersistentNode_retain(node->children[1]);
+	newNode->key = node->key;
+	newNode->value = node->value;
+	return newNode;
+}
+
+RBPersistentNode* RBPersistentNode_makeMutable(RBPersistentTree* tree, RBPersistentNode** link) {
+	// Replaces the node at link, whose holder must already be mutable, by a private copy
+	RBPersistentNode* node = *link;
+	if (NULL == node || tree->version == node->version) {
+		return node;
+	}
+	RBPersistentNode* newNode = RBPersistentNode_copy(tree, node);
+	if (NULL == newNode) {
+		return NULL;
+	}
+	*link = newNode;
+	RBPersistentNode_release(node);
+	return newNode;
+}
+
+RBPersistentNode* RBPersistentNode_rotate(RBPersistentNode* node, int dir) {
+	// dir 0 rotates left, dir 1 rotates right, both nodes must be mutable, returns the new subtree root
+	RBPersistentNode* newParent = node->children[1 - dir];
+	node->children[1 - dir] = newParent->children[dir];
+	newParent->children[dir] = node;
+	return newParent;
+}
+
+RBPersistentNode* RBPersistentNode_retain(RBPersistentNode* node) {
+	if (NULL != node) {
+		atomic_fetch_add_explicit(&node->refCount, 1, memory_order_relaxed);
+	}
+	return node;
+}
+
+void RBPersistentNode_release(RBPersistentNode* node) {
+	// Frees the nodes only this reference kept alive, each holds at most height pending children
+	RBPersistentNode* stack[2 * RBTREE_MAX_HEIGHT];
+	int top = 0;
+	if (NULL != node) {
+		stack[top++] = node;
+	}
+	while (0 < top) {
+		RBPersistentNode* currNode = stack[--top];
+		if (1 != atomic_fetch_sub_explicit(&currNode->refCount, 1, memory_order_acq_rel)) {
+			continue;
+		}
+		for (int i = 0; i < 2; i++) {
+			if (NULL != currNode->children[i]) {
+				stack[top++] = currNode->children[i];
+			}
+		}
+		free(currNode);
+	}
+}
+
+int RBPersistentNode_isRed(RBPersistentNode* node) {
+	return (NULL != node && RED == node->color) ? 1 : 0;
+}
+
+void RBSnapshot_release(RBSnapshot* snapshot) {
+	if (NULL != snapshot) {
+		RBPersistentNode_release(snapshot->root);
+		free(snapshot);
+	}
+}
+
+int RBSnapshot_getSize(RBSnapshot* snapshot) {
+	if (NULL == snapshot) {
+		return 0;
+	}
+	return snapshot->size;
 }
 
-void RBTreeIterator_getNext(RBTreeIterator* iter) {
-	iter->currNode = iter->nextNode;
-	if (NULL == iter->currNode) {
-		iter->nextNode = NULL;
+void* RBSnapshot_search(RBSnapshot* snapshot, void* key) {
+	if (NULL == snapshot || NULL == key) {
+		return NULL;
+	}
+	RBPersistentNode* currNode = snapshot->root;
+	while (NULL != currNode) {
+		int order = snapshot->keyCompareFunction(currNode->key, key);
+		if (0 == order) {
+			return currNode->value;
+		}
+		currNode = currNode->children[0 < order];
+	}
+	return NULL;
+}
+
+int RBSnapshot_forEach(RBSnapshot* snapshot, Visitor visit, void* context) {
+	// In key order, nodes have no parent pointers so the path is kept on a stack
+	if (NULL == snapshot || NULL == visit) {
+		return 0;
+	}
+	RBPersistentNode* stack[RBTREE_MAX_HEIGHT];
+	int top = 0;
+	RBPersistentNode* currNode = snapshot->root;
+	while (NULL != currNode || 0 < top) {
+		while (NULL != currNode) {
+			stack[top++] = currNode;
+			currNode = currNode->children[0];
+		}
+		currNode = stack[--top];
+		int result = visit(currNode->key, currNode->value, context);
+		if (0 != result) {
+			return result;
+		}
+		currNode = currNode->children[1];
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBFrozenTree FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// A frozen tree is a read-only copy of a tree laid out for searching. Slot k of the
+// Eytzinger layout has its children at 2k and 2k + 1, so a lookup walks down one array
+// and the next levels can be prefetched. Bounds are returned as indexes into the
+// ordered keys, which also serve iteration.
+
+RBFrozenTree* RBTree_freeze(RBTree* tree) {
+	// Shares the keys and values of the tree, which must outlive the frozen tree
+	if (NULL == tree) {
+		return NULL;
+	}
+	RBFrozenTree* newTree = calloc(1, sizeof(RBFrozenTree));
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->size = RBTree_size(tree);
+	newTree->keyCompareFunction = tree->keyCompareFunction;
+	newTree->keys = malloc(((size_t)newTree->size + 1) * sizeof(void*));
+	newTree->values = malloc(((size_t)newTree->size + 1) * sizeof(void*));
+	// Cache-line aligned so the eight slots 8k to 8k + 7 below slot k share one line
+	size_t layoutBytes = ((size_t)newTree->size + 1) * sizeof(void*);
+	newTree->layout = aligned_alloc(64, (layoutBytes + 63) & ~(size_t)63);
+	newTree->positions = malloc(((size_t)newTree->size + 1) * sizeof(int));
+	if (NULL == newTree->keys || NULL == newTree->values || NULL == newTree->layout || NULL == newTree->positions) {
+		RBFrozenTree_delete(newTree);
+		return NULL;
+	}
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	for (int i = 0; RBTreeIterator_hasNext(&iter); i++) {
+		RBTreeIterator_getNext(&iter);
+		newTree->keys[i] = RBTreeIterator_getKey(&iter);
+		newTree->values[i] = RBTreeIterator_getValue(&iter);
+	}
+	int next = 0;
+	RBFrozenTree_fillLayout(newTree, 1, &next);
+	return newTree;
+}
+
+RBFrozenTree* RBTree_freezeInt(RBTree* tree) {
+	// For trees of int keys in ascending order, adds blocks searched with SIMD compares
+	RBFrozenTree* newTree = RBTree_freeze(tree);
+	if (NULL == newTree) {
+		return NULL;
+	}
+	for (int i = 1; i < newTree->size; i++) {
+		if (*(int*)newTree->keys[i - 1] > *(int*)newTree->keys[i]) {
+			RBFrozenTree_delete(newTree);
+			return NULL;
+		}
+	}
+	newTree->blockCount = (newTree->size + RBFROZENTREE_BLOCK - 1) / RBFROZENTREE_BLOCK;
+	size_t blockBytes = ((size_t)newTree->blockCount + 1) * RBFROZENTREE_BLOCK * sizeof(int);
+	newTree->blockKeys = aligned_alloc(64, blockBytes);
+	newTree->blockPositions = malloc(blockBytes);
+	if (NULL == newTree->blockKeys || NULL == newTree->blockPositions) {
+		RBFrozenTree_delete(newTree);
+		return NULL;
+	}
+	int next = 0;
+	RBFrozenTree_fillBlocks(newTree, 0, &next);
+	return newTree;
+}
+
+void RBFrozenTree_delete(RBFrozenTree* tree) {
+	if (NULL != tree) {
+		free(tree->keys);
+		free(tree->values);
+		free(tree->layout);
+		free(tree->positions);
+		free(tree->blockKeys);
+		free(tree->blockPositions);
+		free(tree);
+	}
+}
+
+void RBFrozenTree_fillLayout(RBFrozenTree* tree, int slot, int* next) {
+	// An in-order walk of the implicit tree hands out the keys in order
+	if (slot > tree->size) {
 		return;
 	}
+	RBFrozenTree_fillLayout(tree, 2 * slot, next);
+	tree->layout[slot] = tree->keys[*next];
+	tree->positions[slot] = (*next)++;
+	RBFrozenTree_fillLayout(tree, 2 * slot + 1, next);
+}
 
-	if (NULL != RBNode_getRightChild(iter->currNode)) {
-		iter->nextNode = RBNode_getRightChild(iter->currNode);
-		while (NULL != RBNode_getLeftChild(iter->nextNode)) {
-			iter->nextNode = RBNode_getLeftChild(iter->nextNode);
+void RBFrozenTree_fillBlocks(RBFrozenTree* tree, int block, int* next) {
+	// Block k has children k * 17 + 1 to k * 17 + 17, the last block is padded with INT_MAX
+	if (block >= tree->blockCount) {
+		return;
+	}
+	for (int i = 0; i < RBFROZENTREE_BLOCK; i++) {
+		RBFrozenTree_fillBlocks(tree, block * (RBFROZENTREE_BLOCK + 1) + i + 1, next);
+		int slot = block * RBFROZENTREE_BLOCK + i;
+		tree->blockKeys[slot] = (*next < tree->size) ? *(int*)tree->keys[*next] : INT_MAX;
+		tree->blockPositions[slot] = (*next < tree->size) ? (*next)++ : tree->size;
+	}
+	RBFrozenTree_fillBlocks(tree, block * (RBFROZENTREE_BLOCK + 1) + RBFROZENTREE_BLOCK + 1, next);
+}
+
+int RBFrozenTree_getSize(RBFrozenTree* tree) {
+	if (NULL == tree) {
+		return 0;
+	}
+	return tree->size;
+}
+
+void* RBFrozenTree_getKey(RBFrozenTree* tree, int index) {
+	if (NULL == tree || 0 > index || index >= tree->size) {
+		return NULL;
+	}
+	return tree->keys[index];
+}
+
+void* RBFrozenTree_getValue(RBFrozenTree* tree, int index) {
+	if (NULL == tree || 0 > index || index >= tree->size) {
+		return NULL;
+	}
+	return tree->values[index];
+}
+
+int RBFrozenTree_bound(RBFrozenTree* tree, void* key, int inclusive) {
+	// Index of the first key not less than key, or greater than it when inclusive, size when none
+	if (NULL == tree || NULL == key) {
+		return 0;
+	}
+	if (NULL != tree->blockKeys) {
+		return RBFrozenTree_boundInt(tree, *(int*)key, inclusive);
+	}
+	unsigned int slot = 1;
+	while (slot <= (unsigned int)tree->size) {
+		// The aligned line at 8 * slot holds all eight slots three levels down
+		if (8 * slot <= (unsigned int)tree->size) {
+			RBTREE_PREFETCH(tree->layout + 8 * slot);
 		}
-	} else {
-		RBNode* n = iter->currNode;
-		RBNode* p = RBNode_getParent(n);
-		while (NULL != p && n == RBNode_getRightChild(p)) {
-			n = p;
-			p = RBNode_getParent(p);
+		int order = tree->keyCompareFunction(tree->layout[slot], key);
+		slot = 2 * slot + (0 < order || (inclusive && 0 == order));
+	}
+	// Undo the right turns taken after the last left turn, that slot holds the bound
+	while (slot & 1) {
+		slot >>= 1;
+	}
+	slot >>= 1;
+	return (0 == slot) ? tree->size : tree->positions[slot];
+}
+
+int RBFrozenTree_boundInt(RBFrozenTree* tree, int key, int inclusive) {
+	// Each block is one cache line, ranked with four SIMD compares and no branches
+	int bound = tree->size;
+	int block = 0;
+	while (block < tree->blockCount) {
+		int* keys = tree->blockKeys + block * RBFROZENTREE_BLOCK;
+#ifdef RBTREE_SIMD
+		__m128i pivot = _mm_set1_epi32(key);
+		__m128i lanes[4];
+		for (int i = 0; i < 4; i++) {
+			__m128i blockLane = _mm_load_si128((__m128i*)keys + i);
+			lanes[i] = inclusive ? _mm_cmpgt_epi32(blockLane, pivot) : _mm_cmpgt_epi32(pivot, blockLane);
 		}
-		iter->nextNode = p;
+		__m128i packed = _mm_packs_epi16(_mm_packs_epi32(lanes[0], lanes[1]), _mm_packs_epi32(lanes[2], lanes[3]));
+		int matches = __builtin_popcount((unsigned int)_mm_movemask_epi8(packed));
+		int rank = inclusive ? RBFROZENTREE_BLOCK - matches : matches;
+#else
+		int rank = 0;
+		for (int i = 0; i < RBFROZENTREE_BLOCK; i++) {
+			rank += inclusive ? (keys[i] <= key) : (keys[i] < key);
+		}
+#endif
+		if (rank < RBFROZENTREE_BLOCK) {
+			bound = tree->blockPositions[block * RBFROZENTREE_BLOCK + rank];
+		}
+		block = block * (RBFROZENTREE_BLOCK + 1) + rank + 1;
 	}
+	return bound;
 }
 
-void RBTreeIterator_delete(RBTreeIterator* iter) {
-	if (NULL != iter) {
-		free(iter);
+int RBFrozenTree_lowerBound(RBFrozenTree* tree, void* key) {
+	return RBFrozenTree_bound(tree, key, 0);
+}
+
+int RBFrozenTree_upperBound(RBFrozenTree* tree, void* key) {
+	return RBFrozenTree_bound(tree, key, 1);
+}
+
+void* RBFrozenTree_search(RBFrozenTree* tree, void* key) {
+	int index = RBFrozenTree_lowerBound(tree, key);
+	if (NULL == tree || NULL == key || index >= tree->size || 0 != tree->keyCompareFunction(tree->keys[index], key)) {
+		return NULL;
+	}
+	return tree->values[index];
+}
+
+int RBFrozenTree_forEach(RBFrozenTree* tree, Visitor visit, void* context) {
+	if (NULL == tree || NULL == visit) {
+		return 0;
+	}
+	for (int i = 0; i < tree->size; i++) {
+		int result = visit(tree->keys[i], tree->values[i], context);
+		if (0 != result) {
+			return result;
+		}
+	}
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START BTree FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// A BTree is an ordered map like RBTree whose nodes hold up to 31 entries, so a
+// lookup touches about a quarter as many nodes. Trees made by BTree_createInt keep
+// an int copy of each key in a 128-byte array at the start of the node and rank a
+// key against the whole node with SIMD compares.
+
+BTree* BTree_create(Comparator keyCompareFunction) {
+	BTree* newTree = malloc(sizeof(BTree));
+	if (NULL == newTree) {
+		return NULL;
+	}
+	newTree->root = NULL;
+	newTree->keyCompareFunction = keyCompareFunction;
+	newTree->intKeys = 0;
+	newTree->size = 0;
+	return newTree;
+}
+
+BTree* BTree_createInt(void) {
+	// Keys point to ints in ascending order, as with intCompare
+	BTree* newTree = BTree_create(intCompare);
+	if (NULL != newTree) {
+		newTree->intKeys = 1;
+	}
+	return newTree;
+}
+
+void BTree_delete(BTree* tree) {
+	if (NULL != tree) {
+		BTree_deleteNode(tree->root);
+		free(tree);
+	}
+}
+
+void BTree_deleteNode(BTreeNode* node) {
+	// Recursion is only as deep as the tree, a handful of levels
+	if (NULL == node) {
+		return;
+	}
+	if (!node->leaf) {
+		for (int i = 0; i <= node->count; i++) {
+			BTree_deleteNode(node->children[i]);
+		}
+	}
+	free(node);
+}
+
+BTreeNode* BTree_createNode(int leaf) {
+	// Cache-line aligned, so intKeys fills exactly two lines, and leaves get no children array
+	size_t nodeBytes = sizeof(BTreeNode) + (leaf ? 0 : (BTREE_MAX_KEYS + 1) * sizeof(BTreeNode*));
+	nodeBytes = (nodeBytes + 63) / 64 * 64;
+	BTreeNode* newNode = aligned_alloc(64, nodeBytes);
+	if (NULL == newNode) {
+		return NULL;
+	}
+	for (int i = 0; i <= BTREE_MAX_KEYS; i++) {
+		newNode->intKeys[i] = INT_MAX;
+	}
+	newNode->count = 0;
+	newNode->leaf = leaf;
+	return newNode;
+}
+
+int BTree_size(BTree* tree) {
+	if (NULL == tree) {
+		return 0;
+	}
+	return tree->size;
+}
+
+int BTree_rank(BTree* tree, BTreeNode* node, void* key, int inclusive) {
+	// Number of keys in node less than key, or not greater than it when inclusive
+	if (tree->intKeys) {
+		int pivot = *(int*)key;
+		int rank = 0;
+#ifdef RBTREE_SIMD
+		__m128i pivots = _mm_set1_epi32(pivot);
+		for (int i = 0; i <= BTREE_MAX_KEYS; i += 4) {
+			__m128i lane = _mm_load_si128((__m128i*)(node->intKeys + i));
+			__m128i matches = inclusive ? _mm_cmpgt_epi32(lane, pivots) : _mm_cmpgt_epi32(pivots, lane);
+			rank += __builtin_popcount((unsigned int)_mm_movemask_ps(_mm_castsi128_ps(matches)));
+		}
+		// Inclusive ranks count the keys above the pivot, padding included
+		rank = inclusive ? BTREE_MAX_KEYS + 1 - rank : rank;
+#else
+		for (int i = 0; i <= BTREE_MAX_KEYS; i++) {
+			rank += inclusive ? (node->intKeys[i] <= pivot) : (node->intKeys[i] < pivot);
+		}
+#endif
+		return (rank < node->count) ? rank : node->count;
+	}
+	int lo = 0;
+	int hi = node->count;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		int order = tree->keyCompareFunction(node->keys[mid], key);
+		if (0 < order || (inclusive && 0 == order)) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+int BTree_insert(BTree* tree, void* key, void* value) {
+	// Splits full nodes on the way down so the leaf always has room, equal keys go right
+	if (NULL == tree || NULL == key || NULL == value) {
+		return 1;
+	}
+	if (NULL == tree->root) {
+		tree->root = BTree_createNode(1);
+		if (NULL == tree->root) {
+			return 1;
+		}
+	}
+	if (BTREE_MAX_KEYS == tree->root->count) {
+		BTreeNode* newRoot = BTree_createNode(0);
+		if (NULL == newRoot) {
+			return 1;
+		}
+		newRoot->children[0] = tree->root;
+		if (0 != BTree_splitChild(newRoot, 0)) {
+			free(newRoot);
+			return 1;
+		}
+		tree->root = newRoot;
+	}
+	BTreeNode* currNode = tree->root;
+	while (!currNode->leaf) {
+		int index = BTree_rank(tree, currNode, key, 1);
+		if (BTREE_MAX_KEYS == currNode->children[index]->count) {
+			if (0 != BTree_splitChild(currNode, index)) {
+				return 1;
+			}
+			if (0 <= tree->keyCompareFunction(currNode->keys[index], key)) {
+				index++;
+			}
+		}
+		currNode = currNode->children[index];
+	}
+	int index = BTree_rank(tree, currNode, key, 1);
+	int moved = currNode->count - index;
+	memmove(&currNode->keys[index + 1], &currNode->keys[index], (size_t)moved * sizeof(void*));
+	memmove(&currNode->values[index + 1], &currNode->values[index], (size_t)moved * sizeof(void*));
+	memmove(&currNode->intKeys[index + 1], &currNode->intKeys[index], (size_t)moved * sizeof(int));
+	currNode->keys[index] = key;
+	currNode->values[index] = value;
+	currNode->intKeys[index] = tree->intKeys ? *(int*)key : INT_MAX;
+	currNode->count++;
+	tree->size++;
+	return 0;
+}
+
+int BTree_splitChild(BTreeNode* parent, int index) {
+	// Moves the upper half of a full child to a new sibling and its median up into parent
+	BTreeNode* child = parent->children[index];
+	BTreeNode* sibling = BTree_createNode(child->leaf);
+	if (NULL == sibling) {
+		return 1;
+	}
+	int half = BTREE_MIN_DEGREE;
+	sibling->count = BTREE_MIN_DEGREE - 1;
+	memcpy(sibling->keys, &child->keys[half], (size_t)sibling->count * sizeof(void*));
+	memcpy(sibling->values, &child->values[half], (size_t)sibling->count * sizeof(void*));
+	memcpy(sibling->intKeys, &child->intKeys[half], (size_t)sibling->count * sizeof(int));
+	if (!child->leaf) {
+		memcpy(sibling->children, &child->children[half], (size_t)(sibling->count + 1) * sizeof(BTreeNode*));
+	}
+	int moved = parent->count - index;
+	memmove(&parent->keys[index + 1], &parent->keys[index], (size_t)moved * sizeof(void*));
+	memmove(&parent->values[index + 1], &parent->values[index], (size_t)moved * sizeof(void*));
+	memmove(&parent->intKeys[index + 1], &parent->intKeys[index], (size_t)moved * sizeof(int));
+	memmove(&parent->children[index + 2], &parent->children[index + 1], (size_t)moved * sizeof(BTreeNode*));
+	parent->keys[index] = child->keys[half - 1];
+	parent->values[index] = child->values[half - 1];
+	parent->intKeys[index] = child->intKeys[half - 1];
+	parent->children[index + 1] = sibling;
+	parent->count++;
+	child->count = half - 1;
+	for (int i = child->count; i < BTREE_MAX_KEYS; i++) {
+		child->intKeys[i] = INT_MAX;
+	}
+	return 0;
+}
+
+void* BTree_search(BTree* tree, void* key) {
+	if (NULL == tree || NULL == key) {
+		return NULL;
+	}
+	BTreeNode* currNode = tree->root;
+	while (NULL != currNode) {
+		int index = BTree_rank(tree, currNode, key, 0);
+		if (index < currNode->count && 0 == tree->keyCompareFunction(currNode->keys[index], key)) {
+			return currNode->values[index];
+		}
+		currNode = currNode->leaf ? NULL : currNode->children[index];
+	}
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START BTreeIterator FUNCTION DEFINITIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void BTreeIterator_init(BTreeIterator* iter, BTree* tree) {
+	iter->depth = 0;
+	iter->currKey = NULL;
+	iter->currValue = NULL;
+	if (NULL != tree && NULL != tree->root && 0 < tree->root->count) {
+		BTreeIterator_pushLeftmost(iter, tree->root);
+	}
+}
+
+void BTreeIterator_pushLeftmost(BTreeIterator* iter, BTreeNode* node) {
+	while (NULL != node) {
+		iter->path[iter->depth] = node;
+		iter->indexes[iter->depth] = 0;
+		iter->depth++;
+		node = node->leaf ? NULL : node->children[0];
+	}
+}
+
+int BTreeIterator_hasNext(BTreeIterator* iter) {
+	if (NULL == iter) {
+		return 0;
+	}
+	return (0 < iter->depth) ? 1 : 0;
+}
+
+void BTreeIterator_getNext(BTreeIterator* iter) {
+	if (NULL == iter || 0 == iter->depth) {
+		return;
+	}
+	BTreeNode* node = iter->path[iter->depth - 1];
+	int index = iter->indexes[iter->depth - 1]++;
+	iter->currKey = node->keys[index];
+	iter->currValue = node->values[index];
+	if (!node->leaf) {
+		// The keys between this one and the next are in the child to its right
+		BTreeIterator_pushLeftmost(iter, node->children[index + 1]);
+		return;
+	}
+	while (0 < iter->depth && iter->indexes[iter->depth - 1] >= iter->path[iter->depth - 1]->count) {
+		iter->depth--;
+	}
+}
+
+void* BTreeIterator_getKey(BTreeIterator* iter) {
+	if (NULL == iter) {
+		return NULL;
+	}
+	return iter->currKey;
+}
+
+void* BTreeIterator_getValue(BTreeIterator* iter) {
+	if (NULL == iter) {
+		return NULL;
 	}
+	return iter->currValue;
 }
 
 int intCompare(void* int1, void* int2) {
@@ -0,0 +1,649 @@
+// RBTree.h
+// Types and functions of the RBTree library, implemented in RBTree.c
+
+#ifndef RBTREE_H
+#define RBTREE_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// START PREPROCESSOR DIRECTIVES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// pthread_rwlock_t, clock_gettime and mmap need POSIX declarations under -std=c11
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BTREE_MIN_DEGREE 16					// Nodes other than the root hold 15 to 31 keys
+#define BTREE_MAX_KEYS (2 * BTREE_MIN_DEGREE - 1)
+#define BTREE_MAX_HEIGHT 16					// Bound on B-tree height, at most log16(n) + 1
+
+#define LISTNODE_CAPACITY 14				// Values per list chunk, filling two 64-byte cache lines
+#define RBTREE_STATS_DEPTHS 128				// Depths and black heights counted by RBTree_stats
+
+// Define RBTREE_STATS to count comparisons, rotations, recolors and search visits in every tree.
+// Without it the counters are compiled out and RBTree_stats reports them as zero.
+
+// Define RBTREE_COMPACT_NODES, for the library and everything built against it, to keep the
+// color in the low bit of the parent pointer and drop the subtree size, shrinking RBNode from
+// 48 to 40 bytes. Order statistics are unavailable in that build.
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START ListNode STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct List_Node {
+	struct List_Node* next;					// Next node to go to
+	int count;								// Values held, never zero while on a list
+	void* values[LISTNODE_CAPACITY];		// Values of that node, in list order
+} ListNode;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START LinkedList STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Linked_List {
+	int size;								// Number of values in the list
+	ListNode* head;							// First node on the list
+	ListNode* tail;							// Last node on the list, for appending
+} LinkedList;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START LinkedListIterator STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct Linked_List_Iterator {
+	LinkedList* list;						// List to iterate on
+	ListNode* currNode;						// Node of the current value
+	ListNode* nextNode;						// Node of the next value, NULL at the end
+	int currIndex;							// Index of the current value in its node
+	int nextIndex;							// Index of the next value in its node
+} LinkedListIterator;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBNode STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef enum RB_Node_Color {
+	UNDEFINED,
+	RED,
+	BLACK,
+} RBNodeColor;
+
+#ifdef RBTREE_COMPACT_NODES
+typedef struct RB_Node {
+	struct RB_Node* parent;					// Parent of this node, with the low bit set when BLACK
+	struct RB_Node* children[2];			// Children of this node
+	void* key;								// The key of this node
+	void* value;							// The value of this node
+} RBNode;
+#else
+typedef struct RB_Node {
+	RBNodeColor color;					// Color of this node: RED or BLACK
+	int size;								// Nodes in this subtree, kept by augmented trees
+	struct RB_Node* parent;					// Parent of this node
+	struct RB_Node* children[2];			// Children of this node
+	void* key;								// The key of this node
+	void* value;							// The value of this node
+} RBNode;
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBNodeArena STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define RBNODEARENA_DEFAULT_SLAB 4096		// Nodes per slab when no size is given
+
+typedef struct RB_Node_Slab {
+	struct RB_Node_Slab* next;				// Next (older) slab of the arena
+	int capacity;							// Number of nodes in this slab
+	RBNode nodes[];							// The nodes of this slab
+} RBNodeSlab;
+
+// An arena is not locked. Trees sharing one, after RBTree_split or a union that merged
+// arenas, must be written and deleted by one thread at a time.
+typedef struct RB_Node_Arena {
+	RBNodeSlab* slabs;						// Slabs of the arena, newest first
+	int nodesPerSlab;						// Number of nodes in each new slab
+	int nextNode;							// Next never-used node of the newest slab
+	RBNode* freeNodes;						// Released nodes, chained through their parent
+	int refCount;							// Trees, and arenas merged into this one, holding it
+	struct RB_Node_Arena* mergedInto;		// Arena that took over this one's slabs, or NULL
+} RBNodeArena;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTree STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef int (*Comparator)(void*, void*);	// Comparison function between keys
+typedef void* (*Combiner)(void*, void*);	// Merges a new value into an existing one
+typedef int (*Visitor)(void*, void*, void*);	// Called with key, value and context, nonzero stops
+typedef void (*Destructor)(void*);			// Frees a key or value owned by the tree
+
+typedef struct RB_Tree_Entry {
+	void* key;								// Key of the entry
+	void* value;							// Value of the entry
+} RBTreeEntry;
+
+typedef struct RB_Tree_Counters {
+	unsigned long comparisons;				// Calls to the key comparator
+	unsigned long timedComparisons;			// Comparisons sampled for timing
+	unsigned long comparisonNanoseconds;	// Time spent in the sampled comparisons
+	unsigned long leftRotations;			// Calls to RBTree_rotateLeft
+	unsigned long rightRotations;			// Calls to RBTree_rotateRight
+	unsigned long recolors;					// Color changes made while rebalancing
+	unsigned long searches;					// Calls to RBTree_search
+	unsigned long searchVisits;				// Nodes compared by those searches
+} RBTreeCounters;
+
+typedef struct RB_Tree_Stats {
+	RBTreeCounters counters;				// Totals since creation or the last reset
+	int height;								// Nodes on the longest root-to-leaf path
+	long depths[RBTREE_STATS_DEPTHS];		// Nodes at each depth, the root at depth 0
+	long blackHeights[RBTREE_STATS_DEPTHS];	// Empty subtrees reached through each number of black nodes
+} RBTreeStats;
+
+typedef struct RBTree {
+	RBNode* root;							// The root of the tree
+	Comparator keyCompareFunction;			// The comparison function for keys
+	RBNodeArena* arena;						// Node allocator, NULL to use malloc
+	RBNode* freeNodes;						// Removed malloc'd nodes kept for reuse, chained through their parent
+	int size;								// Number of nodes in the tree
+	int augmented;							// Keeps subtree sizes for rank and select
+	int multimap;							// Each node holds a LinkedList of the values of its key
+	Destructor keyDestructor;				// Frees keys as their nodes leave the tree, or NULL
+	Destructor valueDestructor;				// Frees values as their nodes leave the tree, or NULL
+	pthread_rwlock_t lock;					// Guards the Par_ functions
+	atomic_uint sequence;					// Odd while a Par_ writer changes the tree, validates optimistic reads
+#ifdef RBTREE_STATS
+	RBTreeCounters counters;				// Hot-path counters, see RBTree_stats
+#endif
+} RBTree;
+
+typedef struct RB_Node_Chain {
+	RBNode* head;							// First node, the rest are chained through their parent
+	RBNode* tail;							// Last node of the chain
+	int count;								// Number of nodes in the chain
+} RBNodeChain;
+
+typedef struct RB_Tree_Task {
+	RBTree* tree;							// Tree whose comparator and allocator are used
+	RBNode* first;							// Root of the subtree being combined
+	RBNode* second;							// Root of the other subtree, or NULL
+	RBTree* filter;							// Tree probed by intersect and difference
+	int keepIfPresent;						// 1 to intersect, 0 to take the difference
+	int threads;							// Threads this task may use
+	RBNode* result;							// Root of the combined subtree
+	RBNodeChain discarded;					// Nodes dropped by intersect and difference
+} RBTreeTask;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Start RBTreeIterator STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct RBTreeIterator {
+	RBTree* tree;							// Tree to iterate on
+	RBNode* currNode;						// Current node
+	RBNode* nextNode;						// Next node to iterate to
+	RBNode* endNode;						// Node to stop before, NULL to run to the end
+} RBTreeIterator;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBShardedTree STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef unsigned long (*KeyHash)(void*);	// Hash function for keys
+
+typedef struct RB_Sharded_Tree {
+	RBTree** shards;						// Independent trees, one lock each
+	int shardCount;							// Number of shards
+	Comparator keyCompareFunction;			// The comparison function for keys
+	KeyHash keyHashFunction;				// Routes keys by hash, NULL when range partitioned
+	void** splitters;						// shardCount - 1 ascending keys bounding the shards
+} RBShardedTree;
+
+typedef struct RB_Sharded_Tree_Iterator {
+	RBShardedTree* tree;					// Tree to iterate on
+	RBTreeIterator* shardIters;				// One iterator per shard
+	int currShard;							// Shard of the current node, -1 before the first
+} RBShardedTreeIterator;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTreeImage STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef size_t (*Serializer)(void*, void*, size_t);	// Writes an item into a buffer of the given capacity, returns its full length
+typedef void* (*Deserializer)(void*, size_t);	// Rebuilds an item from its bytes, NULL on failure
+
+typedef struct RB_Tree_Image {
+	unsigned char* map;						// The mapped file
+	size_t length;							// Length of the mapping in bytes
+	int count;								// Number of entries in the file
+	uint64_t* offsets;						// Offset of each record from the start of the map, in key order
+	Comparator keyCompareFunction;			// The comparison function for keys
+} RBTreeImage;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBPersistentTree STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct RB_Persistent_Node {
+	atomic_int refCount;					// Parent links, versions and snapshots holding this node
+	RBNodeColor color;						// Color of this node: RED or BLACK
+	unsigned long version;					// Write that created this node, which may change it in place
+	struct RB_Persistent_Node* children[2];	// Children of this node, shared between versions
+	void* key;								// The key of this node
+	void* value;							// The value of this node
+} RBPersistentNode;
+
+typedef struct RB_Persistent_Tree {
+	RBPersistentNode* root;					// Root of the latest version
+	Comparator keyCompareFunction;			// The comparison function for keys
+	int size;								// Number of nodes in the latest version
+	unsigned long version;					// Number of writes so far
+	pthread_mutex_t writeLock;				// Serializes writers
+	pthread_mutex_t rootLock;				// Held only to publish or take a root
+} RBPersistentTree;
+
+typedef struct RB_Snapshot {
+	RBPersistentNode* root;					// Root of the version this snapshot holds
+	Comparator keyCompareFunction;			// The comparison function for keys
+	int size;								// Number of nodes in that version
+} RBSnapshot;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBFrozenTree STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct RB_Frozen_Tree {
+	void** keys;							// Keys in order
+	void** values;							// Values in key order
+	int size;								// Number of entries
+	Comparator keyCompareFunction;			// The comparison function for keys
+	void** layout;							// Keys in Eytzinger (breadth-first) order from index 1
+	int* positions;							// Index in keys of each layout slot
+	int* blockKeys;							// Int keys in blocks of RBFROZENTREE_BLOCK, a 17-ary search tree, or NULL
+	int* blockPositions;					// Index in keys of each block slot, size for padding
+	int blockCount;							// Number of blocks
+} RBFrozenTree;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START BTree STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef struct B_Tree_Node {
+	int intKeys[BTREE_MAX_KEYS + 1];		// Int copies of the keys for SIMD ranking, INT_MAX past count
+	int count;								// Number of keys in this node
+	int leaf;								// 1 when this node has no children
+	void* keys[BTREE_MAX_KEYS];				// The keys of this node, in order
+	void* values[BTREE_MAX_KEYS];			// The values of this node
+	struct B_Tree_Node* children[];			// Children of this node, count + 1 of them, only allocated unless leaf
+} BTreeNode;
+
+typedef struct B_Tree {
+	BTreeNode* root;						// The root of the tree
+	Comparator keyCompareFunction;			// The comparison function for keys
+	int intKeys;							// 1 when keys are ints ranked with SIMD instead of the comparator
+	int size;								// Number of keys in the tree
+} BTree;
+
+typedef struct B_Tree_Iterator {
+	BTreeNode* path[BTREE_MAX_HEIGHT];		// Nodes from the root to the next key
+	int indexes[BTREE_MAX_HEIGHT];			// Next key to visit in each node of the path
+	int depth;								// Length of the path, 0 when done
+	void* currKey;							// Key of the current entry
+	void* currValue;						// Value of the current entry
+} BTreeIterator;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START ListNode FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+ListNode* 			ListNode_create(ListNode*);
+void 				ListNode_delete(ListNode*);
+ListNode*			ListNode_getNext(ListNode*);
+int					ListNode_getCount(ListNode*);
+void* 				ListNode_getValue(ListNode*, int);
+void 				ListNode_setNext(ListNode*, ListNode*);
+void 				ListNode_setValue(ListNode*, int, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START LinkedList FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+LinkedList* 		LinkedList_create();
+void				LinkedList_delete(LinkedList*);
+int					LinkedList_add(LinkedList*, int, void*);
+void*				LinkedList_remove(LinkedList*, int);
+int 				LinkedList_isEmpty(LinkedList*);
+void*				LinkedList_get(LinkedList*, int);
+int 				LinkedList_size(LinkedList*);
+int 				LinkedList_contains(LinkedList*, void*);
+int					LinkedList_append(LinkedList*, void*);
+ListNode*			LinkedList_findNode(LinkedList*, int*, ListNode**);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START LinkedListIterator STRUCTURES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+LinkedListIterator*	LinkedListIterator_create(LinkedList*);
+void				LinkedListIterator_init(LinkedListIterator*, LinkedList*);
+void 				LinkedListIterator_delete(LinkedListIterator*);
+void*				LinkedListIterator_getValue(LinkedListIterator*);
+void 				LinkedListIterator_getNext(LinkedListIterator*);
+int 				LinkedListIterator_hasNext(LinkedListIterator*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBNode FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBNode* 			RBNode_create(RBNodeColor, RBNode*, RBNode*, RBNode*, void*, void*);
+void 				RBNode_delete(RBNode*);
+RBNodeColor 		RBNode_getColor(RBNode*);
+RBNode* 			RBNode_getParent(RBNode*);
+RBNode* 			RBNode_getLeftChild(RBNode*);
+RBNode* 			RBNode_getRightChild(RBNode*);
+int					RBNode_getSize(RBNode*);
+void* 				RBNode_getKey(RBNode*);
+void* 				RBNode_getValue(RBNode*);
+RBNode*				RBNode_getSuccessor(RBNode*);
+void 				RBNode_setColor(RBNode*, RBNodeColor);
+void 				RBNode_setParent(RBNode*, RBNode*);
+void				RBNode_setSize(RBNode*, int);
+void				RBNode_setLeftChild(RBNode*, RBNode*);
+void				RBNode_setRightChild(RBNode*, RBNode*);
+void 				RBNode_setKey(RBNode*, void*);
+void 				RBNode_setValue(RBNode*, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBNodeArena FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBNodeArena*		RBNodeArena_create(int);
+void				RBNodeArena_delete(RBNodeArena*);
+RBNode*				RBNodeArena_alloc(RBNodeArena*);
+void				RBNodeArena_free(RBNodeArena*, RBNode*);
+RBNodeArena*		RBNodeArena_retain(RBNodeArena*);
+int					RBNodeArena_adopt(RBNodeArena*, RBNodeArena*);
+RBNodeArena*		RBNodeArena_find(RBNodeArena*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTree FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBTree* 			RBTree_create(Comparator);
+RBTree*				RBTree_createWithArena(Comparator, int);
+RBTree*				RBTree_buildFromSorted(void**, void**, int, Comparator);
+RBNode*				RBTree_buildFromSorted_recursion(RBTree*, RBNode*, void**, void**, int, int, int, int);
+void 				RBTree_delete(RBTree*);
+void				RBTree_deleteNodes(RBTree*, RBNode*);
+RBTree*				RBTree_createWithDestructors(Comparator, Destructor, Destructor);
+void				RBTree_setDestructors(RBTree*, Destructor, Destructor);
+void				RBTree_destroyEntry(RBTree*, RBNode*);
+RBNode* 			RBTree_getRoot(RBTree*);
+Comparator 			RBTree_getKeyCompareFunction(RBTree*);
+void 				RBTree_setRoot(RBTree*, RBNode*);
+void 				RBTree_setKeyCompareFunction(RBTree*, Comparator);
+int					RBTree_setAugmented(RBTree*, int);
+int					RBTree_isAugmented(RBTree*);
+int					RBTree_setMultimap(RBTree*, int);
+int					RBTree_isMultimap(RBTree*);
+int					RBTree_size(RBTree*);
+int					RBTree_rank(RBTree*, void*);
+void*				RBTree_select(RBTree*, int);
+RBNode*				RBTree_selectNode(RBTree*, int);
+void				RBTree_updateSizesUpward(RBTree*, RBNode*, int);
+RBNode*				RBTree_lowerBound(RBTree*, void*);
+RBNode*				RBTree_upperBound(RBTree*, void*);
+RBNode*				RBTree_createNode(RBTree*, RBNodeColor, RBNode*, RBNode*, RBNode*, void*, void*);
+void				RBTree_deleteNode(RBTree*, RBNode*);
+int					RBTree_compareKeys(RBTree*, void*, void*);
+int					RBTree_insert(RBTree*, void*, void*);
+RBNode*				RBTree_insertFrom(RBTree*, RBNode*, void*, void*);
+RBNode*				RBTree_attachNode(RBTree*, RBNode*, int, void*, void*);
+int					RBTree_upsert(RBTree*, void*, void*, Combiner);
+int					RBTree_append(RBTree*, void*, void*);
+// Inserts all n entries or, returning 1, none of them: the nodes are reserved before the tree is touched
+int					RBTree_insertBatch(RBTree*, void**, void**, int);
+int					RBTree_reserveNodes(RBTree*, int);
+void				RBTree_sortEntries(RBTree*, RBTreeEntry*, RBTreeEntry*, int);
+void 				RBTree_repairAfterInsert(RBTree*, RBNode*);
+void* 				RBTree_search(RBTree*, void*);
+LinkedList*			RBTree_searchGroup(RBTree*, void*);
+int					RBTree_searchBatch(RBTree*, void**, void**, int);
+int					RBTree_forEach(RBTree*, Visitor, void*);
+int					RBTree_forEachReverse(RBTree*, Visitor, void*);
+int					RBTree_forEachInDirection(RBTree*, Visitor, void*, int);
+int 				RBTree_remove(RBTree*, void*);
+int					RBTree_removeValue(RBTree*, void*, void*);
+void				RBTree_removeNode(RBTree*, RBNode*);
+void 				RBTree_repairAfterRemove(RBTree*, RBNode*, RBNode*);
+void				RBTree_transplant(RBTree*, RBNode*, RBNode*);
+int					RBTree_popMin(RBTree*, void**, void**);
+int					RBTree_popMax(RBTree*, void**, void**);
+int					RBTree_canShareNodes(RBTree*, RBTree*);
+int					RBTree_canCombine(RBTree*, RBTree*, int);
+void				RBTree_takeNodes(RBTree*, RBTree*);
+void				RBTree_initScratch(RBTree*, RBTree*, RBNode*);
+int					RBTree_join(RBTree*, void*, void*, RBTree*);
+RBTree*				RBTree_split(RBTree*, void*);
+int					RBTree_countFirstHalf(RBNode*, RBNode*, int);
+int					RBTree_union(RBTree*, RBTree*);
+int					RBTree_intersect(RBTree*, RBTree*);
+int					RBTree_difference(RBTree*, RBTree*);
+int					RBTree_combine(RBTree*, RBTree*, int, int);
+int					RBNode_getBlackHeight(RBNode*);
+RBNode*				RBTree_joinNodes(RBTree*, RBNode*, RBNode*, RBNode*);
+RBNode*				RBTree_join2Nodes(RBTree*, RBNode*, RBNode*);
+void				RBTree_splitNodes(RBTree*, RBNode*, void*, RBNode**, RBNode**);
+void*				RBTree_combineNodes(void*);
+void				RBNodeChain_append(RBNodeChain*, RBNodeChain*);
+void 				RBTree_rotateLeft(RBTree*, RBNode*);
+void 				RBTree_rotateRight(RBTree*, RBNode*);
+void				RBTree_recolor(RBTree*, RBNode*, RBNodeColor);
+int					RBTree_stats(RBTree*, RBTreeStats*);
+void				RBTree_addStats(RBTree*, RBTree*);
+void				RBTree_resetStats(RBTree*);
+
+int					intCompare(void*, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START Par_RBTree FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int					Par_RBTree_insert(RBTree*, void*, void*);
+void*				Par_RBTree_search(RBTree*, void*);
+void*				Par_RBTree_searchOptimistic(RBTree*, void*);
+void				Par_RBTree_beginWrite(RBTree*);
+void				Par_RBTree_endWrite(RBTree*);
+int					Par_RBTree_remove(RBTree*, void*);
+int					Par_RBTree_upsert(RBTree*, void*, void*, Combiner);
+int					Par_RBTree_union(RBTree*, RBTree*, int);
+int					Par_RBTree_intersect(RBTree*, RBTree*, int);
+int					Par_RBTree_difference(RBTree*, RBTree*, int);
+int					Par_RBTree_combine(RBTree*, RBTree*, int, int);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTreeIterator FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBTreeIterator*		RBTreeIterator_create(RBTree*);
+RBTreeIterator*		RBTreeIterator_createRange(RBTree*, void*, void*);
+void				RBTreeIterator_init(RBTreeIterator*, RBTree*);
+void				RBTreeIterator_initRange(RBTreeIterator*, RBTree*, void*, void*);
+int					RBTreeIterator_split(RBTree*, RBTreeIterator*, int);
+int					RBTreeIterator_collectTop(RBNode*, int, RBNode**, int);
+void 				RBTreeIterator_delete(RBTreeIterator*);
+void* 				RBTreeIterator_getKey(RBTreeIterator*);
+void*				RBTreeIterator_getValue(RBTreeIterator*);
+void 				RBTreeIterator_getNext(RBTreeIterator*);
+int 				RBTreeIterator_hasNext(RBTreeIterator*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBShardedTree FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBShardedTree*		RBShardedTree_create(Comparator, int);
+RBShardedTree*		RBShardedTree_createHashed(Comparator, KeyHash, int);
+RBShardedTree*		RBShardedTree_createRanged(Comparator, void**, int);
+void				RBShardedTree_delete(RBShardedTree*);
+int					RBShardedTree_getShardIndex(RBShardedTree*, void*);
+RBTree*				RBShardedTree_getShard(RBShardedTree*, int);
+int					RBShardedTree_insert(RBShardedTree*, void*, void*);
+int					RBShardedTree_upsert(RBShardedTree*, void*, void*, Combiner);
+void*				RBShardedTree_search(RBShardedTree*, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBShardedTreeIterator FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBShardedTreeIterator*	RBShardedTreeIterator_create(RBShardedTree*);
+void				RBShardedTreeIterator_delete(RBShardedTreeIterator*);
+void*				RBShardedTreeIterator_getKey(RBShardedTreeIterator*);
+void*				RBShardedTreeIterator_getValue(RBShardedTreeIterator*);
+void				RBShardedTreeIterator_getNext(RBShardedTreeIterator*);
+int					RBShardedTreeIterator_hasNext(RBShardedTreeIterator*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTreeImage FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int					RBTree_save(RBTree*, const char*, Serializer, Serializer);
+size_t				RBTree_serializeItem(Serializer, void*, unsigned char**, size_t*);
+RBTree*				RBTree_load(const char*, Comparator, Deserializer, Deserializer, Destructor, Destructor);
+RBTree*				RBTree_loadImage(RBTreeImage*, Deserializer, Deserializer, Destructor, Destructor);
+RBTreeImage*		RBTreeImage_open(const char*, Comparator);
+void				RBTreeImage_close(RBTreeImage*);
+int					RBTreeImage_getCount(RBTreeImage*);
+void*				RBTreeImage_getKey(RBTreeImage*, int, size_t*);
+void*				RBTreeImage_getValue(RBTreeImage*, int, size_t*);
+int					RBTreeImage_lowerBound(RBTreeImage*, void*);
+void*				RBTreeImage_search(RBTreeImage*, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBPersistentTree FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBPersistentTree*	RBPersistentTree_create(Comparator);
+void				RBPersistentTree_delete(RBPersistentTree*);
+int					RBPersistentTree_insert(RBPersistentTree*, void*, void*);
+int					RBPersistentTree_remove(RBPersistentTree*, void*);
+RBSnapshot*			RBPersistentTree_snapshot(RBPersistentTree*);
+void				RBPersistentTree_publish(RBPersistentTree*, RBPersistentNode*, int);
+RBPersistentNode*	RBPersistentNode_copy(RBPersistentTree*, RBPersistentNode*);
+RBPersistentNode*	RBPersistentNode_makeMutable(RBPersistentTree*, RBPersistentNode**);
+RBPersistentNode*	RBPersistentNode_rotate(RBPersistentNode*, int);
+RBPersistentNode*	RBPersistentNode_retain(RBPersistentNode*);
+void				RBPersistentNode_release(RBPersistentNode*);
+int					RBPersistentNode_isRed(RBPersistentNode*);
+void				RBSnapshot_release(RBSnapshot*);
+int					RBSnapshot_getSize(RBSnapshot*);
+void*				RBSnapshot_search(RBSnapshot*, void*);
+int					RBSnapshot_forEach(RBSnapshot*, Visitor, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBFrozenTree FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+RBFrozenTree*		RBTree_freeze(RBTree*);
+RBFrozenTree*		RBTree_freezeInt(RBTree*);
+void				RBFrozenTree_delete(RBFrozenTree*);
+void				RBFrozenTree_fillLayout(RBFrozenTree*, int, int*);
+void				RBFrozenTree_fillBlocks(RBFrozenTree*, int, int*);
+int					RBFrozenTree_getSize(RBFrozenTree*);
+void*				RBFrozenTree_getKey(RBFrozenTree*, int);
+void*				RBFrozenTree_getValue(RBFrozenTree*, int);
+int					RBFrozenTree_bound(RBFrozenTree*, void*, int);
+int					RBFrozenTree_boundInt(RBFrozenTree*, int, int);
+int					RBFrozenTree_lowerBound(RBFrozenTree*, void*);
+int					RBFrozenTree_upperBound(RBFrozenTree*, void*);
+void*				RBFrozenTree_search(RBFrozenTree*, void*);
+int					RBFrozenTree_forEach(RBFrozenTree*, Visitor, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START BTree FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+BTree*				BTree_create(Comparator);
+BTree*				BTree_createInt(void);
+void				BTree_delete(BTree*);
+void				BTree_deleteNode(BTreeNode*);
+BTreeNode*			BTree_createNode(int);
+int					BTree_size(BTree*);
+int					BTree_rank(BTree*, BTreeNode*, void*, int);
+int					BTree_insert(BTree*, void*, void*);
+int					BTree_splitChild(BTreeNode*, int);
+void*				BTree_search(BTree*, void*);
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START BTreeIterator FUNCTION DECLARATIONS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void				BTreeIterator_init(BTreeIterator*, BTree*);
+void				BTreeIterator_pushLeftmost(BTreeIterator*, BTreeNode*);
+int					BTreeIterator_hasNext(BTreeIterator*);
+void				BTreeIterator_getNext(BTreeIterator*);
+void*				BTreeIterator_getKey(BTreeIterator*);
+void*				BTreeIterator_getValue(BTreeIterator*);
+
+#endif
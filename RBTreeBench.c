@@ -0,0 +1,1314 @@
+// RBTreeBench.c
+// Benchmarks for the RBTree library. Build with make, or with:
+//     cc -O2 -pthread -o RBTreeBench RBTreeBench.c RBTree.c -lm
+// Add -DRBTREE_COMPACT_NODES to both files to measure the compact generic node layout.
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// START PREPROCESSOR DIRECTIVES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+// getopt, getrusage and clock_gettime are POSIX, not plain C11
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "RBTree.h"
+#include "RBTreeTemplate.h"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#define BENCH_MAX_SIZES 32					// Key counts one run accepts through -s
+
+RBTREE_DEFINE(BenchIntTree, int, int*, RBTREE_CMP_NUMERIC)
+RBTREE_DEFINE_INDEXED(BenchIndexedTree, int, int*, RBTREE_CMP_NUMERIC)
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START Bench HELPERS
+//
+////////////////////////////////////////////////////////////////////////////////
+
+double Bench_now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int* Bench_randomKeys(int n, unsigned int seed) {
+	int* keys = malloc((size_t)n * sizeof(int));
+	if (NULL == keys) {
+		return NULL;
+	}
+	srand(seed);
+	for (int i = 0; i < n; i++) {
+		keys[i] = rand();
+	}
+	return keys;
+}
+
+void Bench_report(const char* name, int n, double seconds) {
+	printf("%-24s n=%-10d %8.1f ns/op %10.2f Mops/s\n", name, n, seconds * 1e9 / n, n / seconds / 1e6);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START Bench CASES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+void Bench_insertDelete(const char* name, RBTree* tree, int* keys, int n) {
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	double inserted = Bench_now();
+	RBTree_delete(tree);
+	double deleted = Bench_now();
+
+	char label[64];
+	snprintf(label, sizeof(label), "%s insert", name);
+	Bench_report(label, n, inserted - start);
+	snprintf(label, sizeof(label), "%s delete", name);
+	Bench_report(label, n, deleted - inserted);
+}
+
+int Bench_intAscending(const void* a, const void* b) {
+	return (*(const int*)a > *(const int*)b) - (*(const int*)a < *(const int*)b);
+}
+
+void Bench_buildFromSorted(int* keys, int n) {
+	int* sortedKeys = malloc((size_t)n * sizeof(int));
+	void** keyPtrs = malloc((size_t)n * sizeof(void*));
+	if (NULL == sortedKeys || NULL == keyPtrs) {
+		free(sortedKeys);
+		free(keyPtrs);
+		return;
+	}
+	memcpy(sortedKeys, keys, (size_t)n * sizeof(int));
+	qsort(sortedKeys, n, sizeof(int), Bench_intAscending);
+	for (int i = 0; i < n; i++) {
+		keyPtrs[i] = &sortedKeys[i];
+	}
+
+	double start = Bench_now();
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, keyPtrs[i], keyPtrs[i]);
+	}
+	double inserted = Bench_now();
+	RBTree_delete(tree);
+
+	double built = Bench_now();
+	tree = RBTree_buildFromSorted(keyPtrs, keyPtrs, n, intCompare);
+	double finished = Bench_now();
+	RBTree_delete(tree);
+
+	Bench_report("sorted insert", n, inserted - start);
+	Bench_report("buildFromSorted", n, finished - built);
+	free(sortedKeys);
+	free(keyPtrs);
+}
+
+typedef struct Bench_Thread_Args {
+	RBTree* tree;							// Shared tree
+	int* keys;								// Keys to look up or insert
+	int n;									// Number of keys
+	int ops;								// Operations for this thread
+	int writePercent;						// Share of operations that insert
+	unsigned int seed;						// Per-thread random seed
+} BenchThreadArgs;
+
+void* Bench_parallelWorker(void* arg) {
+	BenchThreadArgs* args = arg;
+	unsigned int seed = args->seed;
+	for (int i = 0; i < args->ops; i++) {
+		int* key = &args->keys[rand_r(&seed) % args->n];
+		if ((int)(rand_r(&seed) % 100) < args->writePercent) {
+			Par_RBTree_insert(args->tree, key, key);
+		} else {
+			Par_RBTree_search(args->tree, key);
+		}
+	}
+	return NULL;
+}
+
+void Bench_parallel(int* keys, int n, int maxThreads, int writePercent) {
+	int ops = (n < 1000000) ? 1000000 : n;
+	pthread_t* threads = malloc((size_t)maxThreads * sizeof(pthread_t));
+	BenchThreadArgs* args = malloc((size_t)maxThreads * sizeof(BenchThreadArgs));
+	if (NULL == threads || NULL == args) {
+		free(threads);
+		free(args);
+		return;
+	}
+	for (int threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		RBTree* tree = RBTree_createWithArena(intCompare, 0);
+		for (int i = 0; i < n; i++) {
+			RBTree_insert(tree, &keys[i], &keys[i]);
+		}
+		double start = Bench_now();
+		for (int t = 0; t < threadCount; t++) {
+			args[t] = (BenchThreadArgs){ tree, keys, n, ops / threadCount, writePercent, 1234u + (unsigned int)t };
+			pthread_create(&threads[t], NULL, Bench_parallelWorker, &args[t]);
+		}
+		for (int t = 0; t < threadCount; t++) {
+			pthread_join(threads[t], NULL);
+		}
+		double finished = Bench_now();
+		RBTree_delete(tree);
+
+		char label[64];
+		snprintf(label, sizeof(label), "par %d%%w %dthr", writePercent, threadCount);
+		Bench_report(label, ops / threadCount * threadCount, finished - start);
+	}
+	free(threads);
+	free(args);
+}
+
+typedef struct Bench_Shard_Args {
+	RBShardedTree* tree;					// Shared sharded tree
+	int* keys;								// Keys to insert
+	int from;								// First key of this thread
+	int to;									// One past the last key of this thread
+} BenchShardArgs;
+
+unsigned long Bench_intHash(void* key) {
+	return (unsigned long)(unsigned int)*(int*)key * 2654435761u;
+}
+
+void* Bench_shardedWorker(void* arg) {
+	BenchShardArgs* args = arg;
+	for (int i = args->from; i < args->to; i++) {
+		RBShardedTree_insert(args->tree, &args->keys[i], &args->keys[i]);
+	}
+	return NULL;
+}
+
+void Bench_sharded(int* keys, int n, int maxThreads) {
+	pthread_t* threads = malloc((size_t)maxThreads * sizeof(pthread_t));
+	BenchShardArgs* args = malloc((size_t)maxThreads * sizeof(BenchShardArgs));
+	if (NULL == threads || NULL == args) {
+		free(threads);
+		free(args);
+		return;
+	}
+	for (int threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		RBShardedTree* tree = RBShardedTree_createHashed(intCompare, Bench_intHash, 4 * threadCount);
+		double start = Bench_now();
+		for (int t = 0; t < threadCount; t++) {
+			args[t] = (BenchShardArgs){ tree, keys, (int)((long)n * t / threadCount), (int)((long)n * (t + 1) / threadCount) };
+			pthread_create(&threads[t], NULL, Bench_shardedWorker, &args[t]);
+		}
+		for (int t = 0; t < threadCount; t++) {
+			pthread_join(threads[t], NULL);
+		}
+		double finished = Bench_now();
+		RBShardedTree_delete(tree);
+
+		char label[64];
+		snprintf(label, sizeof(label), "sharded insert %dthr", threadCount);
+		Bench_report(label, n, finished - start);
+	}
+	free(threads);
+	free(args);
+}
+
+void Bench_typed(int* keys, int n) {
+	RBTree* tree = RBTree_create(intCompare);
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	double inserted = Bench_now();
+	for (int i = 0; i < n; i++) {
+		RBTree_search(tree, &keys[i]);
+	}
+	double searched = Bench_now();
+	RBTree_delete(tree);
+	Bench_report("generic insert", n, inserted - start);
+	Bench_report("generic search", n, searched - inserted);
+
+	BenchIntTree* typedTree = BenchIntTree_create();
+	start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		BenchIntTree_insert(typedTree, keys[i], &keys[i]);
+	}
+	inserted = Bench_now();
+	for (int i = 0; i < n; i++) {
+		BenchIntTree_search(typedTree, keys[i]);
+	}
+	searched = Bench_now();
+	BenchIntTree_delete(typedTree);
+	Bench_report("typed insert", n, inserted - start);
+	Bench_report("typed search", n, searched - inserted);
+
+	BenchIndexedTree* indexedTree = BenchIndexedTree_create();
+	start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		BenchIndexedTree_insert(indexedTree, keys[i], &keys[i]);
+	}
+	inserted = Bench_now();
+	for (int i = 0; i < n; i++) {
+		BenchIndexedTree_search(indexedTree, keys[i]);
+	}
+	searched = Bench_now();
+	BenchIndexedTree_delete(indexedTree);
+	Bench_report("indexed insert", n, inserted - start);
+	Bench_report("indexed search", n, searched - inserted);
+	printf("node bytes: generic %zu, typed %zu, indexed %zu\n",
+		sizeof(RBNode), sizeof(BenchIntTreeNode), sizeof(BenchIndexedTreeNode));
+}
+
+#define BENCH_BATCH_SIZE 4096				// Records per insertBatch call
+
+void Bench_batch(const char* name, int* keys, int n) {
+	void** keyPtrs = malloc((size_t)n * sizeof(void*));
+	if (NULL == keyPtrs) {
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		keyPtrs[i] = &keys[i];
+	}
+
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, keyPtrs[i], keyPtrs[i]);
+	}
+	double inserted = Bench_now();
+	RBTree_delete(tree);
+
+	tree = RBTree_createWithArena(intCompare, 0);
+	double batchStart = Bench_now();
+	for (int i = 0; i < n; i += BENCH_BATCH_SIZE) {
+		int count = (n - i < BENCH_BATCH_SIZE) ? n - i : BENCH_BATCH_SIZE;
+		RBTree_insertBatch(tree, keyPtrs + i, keyPtrs + i, count);
+	}
+	double batchInserted = Bench_now();
+	RBTree_delete(tree);
+
+	char label[64];
+	snprintf(label, sizeof(label), "%s single", name);
+	Bench_report(label, n, inserted - start);
+	snprintf(label, sizeof(label), "%s batch", name);
+	Bench_report(label, n, batchInserted - batchStart);
+	free(keyPtrs);
+}
+
+void Bench_batches(int* keys, int n) {
+	int* batchKeys = malloc((size_t)n * sizeof(int));
+	if (NULL == batchKeys) {
+		return;
+	}
+	Bench_batch("random", keys, n);
+
+	// Each batch draws from a narrow window around a random centre
+	srand(7);
+	for (int i = 0; i < n; i++) {
+		if (0 == i % BENCH_BATCH_SIZE) {
+			srand(rand());
+		}
+		batchKeys[i] = keys[i - i % BENCH_BATCH_SIZE] / 2 + rand() % (4 * BENCH_BATCH_SIZE);
+	}
+	Bench_batch("clustered", batchKeys, n);
+
+	memcpy(batchKeys, keys, (size_t)n * sizeof(int));
+	qsort(batchKeys, n, sizeof(int), Bench_intAscending);
+	Bench_batch("sorted", batchKeys, n);
+	free(batchKeys);
+}
+
+void Bench_searchBatch(int* keys, int n) {
+	void** keyPtrs = malloc((size_t)n * sizeof(void*));
+	void** values = malloc((size_t)n * sizeof(void*));
+	if (NULL == keyPtrs || NULL == values) {
+		free(keyPtrs);
+		free(values);
+		return;
+	}
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	// Probe in a different order than the keys were inserted
+	srand(99);
+	for (int i = 0; i < n; i++) {
+		keyPtrs[i] = &keys[rand() % n];
+	}
+
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		values[i] = RBTree_search(tree, keyPtrs[i]);
+	}
+	double searched = Bench_now();
+	RBTree_searchBatch(tree, keyPtrs, values, n);
+	double batchSearched = Bench_now();
+	RBTree_delete(tree);
+
+	Bench_report("search single", n, searched - start);
+	Bench_report("search batch", n, batchSearched - searched);
+	free(keyPtrs);
+	free(values);
+}
+
+void Bench_churn(int* keys, int n) {
+	// Sliding window: drop the oldest key and insert a new one
+	RBTree* tree = RBTree_create(intCompare);
+	int window = n / 2;
+	for (int i = 0; i < window; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	double start = Bench_now();
+	for (int i = window; i < n; i++) {
+		RBTree_remove(tree, &keys[i - window]);
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	double finished = Bench_now();
+	RBTree_delete(tree);
+	Bench_report("churn remove+insert", n - window, finished - start);
+}
+
+void Bench_union(int* keys, int n, int maxThreads) {
+	// Merge two halves, once by reinserting and once by joining
+	int half = n / 2;
+	RBTree* tree = RBTree_create(intCompare);
+	RBTree* other = RBTree_create(intCompare);
+	for (int i = 0; i < half; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+		RBTree_insert(other, &keys[half + i], &keys[half + i]);
+	}
+	double start = Bench_now();
+	RBTreeIterator* iter = RBTreeIterator_create(other);
+	while (RBTreeIterator_hasNext(iter)) {
+		RBTreeIterator_getNext(iter);
+		RBTree_insert(tree, RBTreeIterator_getKey(iter), RBTreeIterator_getValue(iter));
+	}
+	RBTreeIterator_delete(iter);
+	double finished = Bench_now();
+	RBTree_delete(tree);
+	RBTree_delete(other);
+	Bench_report("union by reinsert", half, finished - start);
+
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		tree = RBTree_create(intCompare);
+		other = RBTree_create(intCompare);
+		for (int i = 0; i < half; i++) {
+			RBTree_insert(tree, &keys[i], &keys[i]);
+			RBTree_insert(other, &keys[half + i], &keys[half + i]);
+		}
+		start = Bench_now();
+		Par_RBTree_union(tree, other, threads);
+		finished = Bench_now();
+		RBTree_delete(tree);
+
+		char label[64];
+		snprintf(label, sizeof(label), "union by join %dthr", threads);
+		Bench_report(label, half, finished - start);
+	}
+}
+
+void* Bench_addCounts(void* existing, void* incoming) {
+	*(long*)existing += *(long*)incoming;
+	return existing;
+}
+
+void Bench_upsert(int* keys, int n) {
+	// Word-count style aggregation over keys repeating about ten times each
+	int distinct = (10 < n) ? n / 10 : 1;
+	int* words = malloc((size_t)n * sizeof(int));
+	long* counts = malloc((size_t)n * sizeof(long));
+	if (NULL == words || NULL == counts) {
+		free(words);
+		free(counts);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		words[i] = keys[i] % distinct;
+		counts[i] = 1;
+	}
+
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		long* count = RBTree_search(tree, &words[i]);
+		if (NULL == count) {
+			RBTree_insert(tree, &words[i], &counts[i]);
+		} else {
+			(*count)++;
+		}
+	}
+	double searched = Bench_now();
+	RBTree_delete(tree);
+	for (int i = 0; i < n; i++) {
+		counts[i] = 1;
+	}
+
+	tree = RBTree_createWithArena(intCompare, 0);
+	double upsertStart = Bench_now();
+	for (int i = 0; i < n; i++) {
+		RBTree_upsert(tree, &words[i], &counts[i], Bench_addCounts);
+	}
+	double upserted = Bench_now();
+	RBTree_delete(tree);
+
+	Bench_report("count search+insert", n, searched - start);
+	Bench_report("count upsert", n, upserted - upsertStart);
+	free(words);
+	free(counts);
+}
+
+int Bench_sumKeys(void* key, void* value, void* context) {
+	(void)value;
+	*(long*)context += *(int*)key;
+	return 0;
+}
+
+void Bench_scan(int* keys, int n) {
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	long sum = 0;
+	double start = Bench_now();
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	while (RBTreeIterator_hasNext(&iter)) {
+		RBTreeIterator_getNext(&iter);
+		sum += *(int*)RBTreeIterator_getKey(&iter);
+	}
+	double iterated = Bench_now();
+	RBTree_forEach(tree, Bench_sumKeys, &sum);
+	double visited = Bench_now();
+	RBTree_delete(tree);
+
+	Bench_report("scan iterator", n, iterated - start);
+	Bench_report("scan forEach", n, visited - iterated);
+	if (0 == sum) {
+		printf("\n");
+	}
+}
+
+typedef struct Bench_Scan_Args {
+	RBTreeIterator iter;					// Range of this thread
+	long sum;								// Sum of the keys in the range
+} BenchScanArgs;
+
+void* Bench_scanWorker(void* arg) {
+	BenchScanArgs* args = arg;
+	while (RBTreeIterator_hasNext(&args->iter)) {
+		RBTreeIterator_getNext(&args->iter);
+		args->sum += *(int*)RBTreeIterator_getKey(&args->iter);
+	}
+	return NULL;
+}
+
+void Bench_parallelScan(int* keys, int n, int maxThreads) {
+	pthread_t* threads = malloc((size_t)maxThreads * sizeof(pthread_t));
+	BenchScanArgs* args = malloc((size_t)maxThreads * sizeof(BenchScanArgs));
+	RBTreeIterator* iters = malloc((size_t)maxThreads * sizeof(RBTreeIterator));
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	if (NULL == threads || NULL == args || NULL == iters || NULL == tree) {
+		free(threads);
+		free(args);
+		free(iters);
+		RBTree_delete(tree);
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	for (int threadCount = 1; threadCount <= maxThreads; threadCount++) {
+		double start = Bench_now();
+		RBTreeIterator_split(tree, iters, threadCount);
+		for (int t = 0; t < threadCount; t++) {
+			args[t].iter = iters[t];
+			args[t].sum = 0;
+			pthread_create(&threads[t], NULL, Bench_scanWorker, &args[t]);
+		}
+		for (int t = 0; t < threadCount; t++) {
+			pthread_join(threads[t], NULL);
+		}
+		double finished = Bench_now();
+
+		char label[64];
+		snprintf(label, sizeof(label), "split scan %dthr", threadCount);
+		Bench_report(label, n, finished - start);
+	}
+	RBTree_delete(tree);
+	free(threads);
+	free(args);
+	free(iters);
+}
+
+RBTree* Bench_ownedTree(int* keys, int n, Destructor keyDestructor) {
+	// Each key is a separate allocation owned by the tree, as with heap strings
+	RBTree* tree = RBTree_createWithDestructors(intCompare, keyDestructor, NULL);
+	for (int i = 0; NULL != tree && i < n; i++) {
+		int* key = malloc(sizeof(int));
+		*key = keys[i];
+		RBTree_insert(tree, key, key);
+	}
+	return tree;
+}
+
+void Bench_teardown(int* keys, int n) {
+	// Freeing keys in a separate pass before the delete, against one pass with a destructor
+	RBTree* tree = Bench_ownedTree(keys, n, NULL);
+	double start = Bench_now();
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	while (RBTreeIterator_hasNext(&iter)) {
+		RBTreeIterator_getNext(&iter);
+		free(RBTreeIterator_getKey(&iter));
+	}
+	RBTree_delete(tree);
+	double twoPass = Bench_now() - start;
+
+	tree = Bench_ownedTree(keys, n, free);
+	start = Bench_now();
+	RBTree_delete(tree);
+	double onePass = Bench_now() - start;
+
+	Bench_report("teardown two-pass", n, twoPass);
+	Bench_report("teardown destructor", n, onePass);
+}
+
+size_t Bench_serializeInt(void* item, void* buffer, size_t capacity) {
+	if (sizeof(int) <= capacity) {
+		memcpy(buffer, item, sizeof(int));
+	}
+	return sizeof(int);
+}
+
+void* Bench_deserializeInt(void* bytes, size_t length) {
+	int* item = malloc(sizeof(int));
+	if (NULL != item && sizeof(int) == length) {
+		memcpy(item, bytes, sizeof(int));
+	}
+	return item;
+}
+
+void Bench_snapshot(int* keys, int n) {
+	// Restarting from a checkpoint by reinserting, against loading or mapping a saved file
+	char path[64];
+	snprintf(path, sizeof(path), "/tmp/RBTreeBench-%d.snapshot", (int)getpid());
+	RBTree* tree = RBTree_createWithArena(intCompare, 0);
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		RBTree_insert(tree, &keys[i], &keys[i]);
+	}
+	double inserted = Bench_now();
+	int failed = RBTree_save(tree, path, Bench_serializeInt, Bench_serializeInt);
+	double saved = Bench_now();
+	RBTree_delete(tree);
+	if (0 != failed) {
+		return;
+	}
+
+	double loadStart = Bench_now();
+	RBTree* loaded = RBTree_load(path, intCompare, Bench_deserializeInt, Bench_deserializeInt, free, free);
+	double load = Bench_now();
+	RBTree_delete(loaded);
+	double openStart = Bench_now();
+	RBTreeImage* image = RBTreeImage_open(path, intCompare);
+	double opened = Bench_now();
+	for (int i = 0; NULL != image && i < n; i++) {
+		RBTreeImage_search(image, &keys[i]);
+	}
+	double searched = Bench_now();
+	RBTreeImage_close(image);
+	unlink(path);
+
+	Bench_report("snapshot reinsert", n, inserted - start);
+	Bench_report("snapshot save", n, saved - inserted);
+	Bench_report("snapshot load", n, load - loadStart);
+	Bench_report("image open", n, opened - openStart);
+	Bench_report("image search", n, searched - opened);
+}
+
+typedef struct Bench_Reader_Args {
+	RBTree* tree;							// Locked tree to read, or NULL
+	RBPersistentTree* persistentTree;		// Persistent tree to read through snapshots, or NULL
+	int optimistic;							// 1 to read the locked tree without taking its lock
+	int* keys;								// Keys to look up
+	int n;									// Number of keys
+	atomic_int* writing;					// Cleared once the writer is done
+	long lookups;							// Lookups done by this reader
+} BenchReaderArgs;
+
+void* Bench_readerWorker(void* arg) {
+	// Looks up batches of keys until the writer finishes, a persistent reader takes one snapshot per batch
+	BenchReaderArgs* args = arg;
+	unsigned int seed = 99u;
+	while (atomic_load(args->writing)) {
+		RBSnapshot* snapshot = (NULL == args->persistentTree) ? NULL : RBPersistentTree_snapshot(args->persistentTree);
+		for (int i = 0; i < 1024; i++) {
+			int* key = &args->keys[rand_r(&seed) % args->n];
+			if (NULL != snapshot) {
+				RBSnapshot_search(snapshot, key);
+			} else if (args->optimistic) {
+				Par_RBTree_searchOptimistic(args->tree, key);
+			} else {
+				Par_RBTree_search(args->tree, key);
+			}
+		}
+		RBSnapshot_release(snapshot);
+		args->lookups += 1024;
+	}
+	return NULL;
+}
+
+void Bench_readersWithWriter(int* keys, int n, int maxThreads) {
+	// One writer inserts every key while the other threads read, through the lock, optimistically or from snapshots
+	int readerCount = (1 < maxThreads) ? maxThreads - 1 : 1;
+	pthread_t* threads = malloc((size_t)readerCount * sizeof(pthread_t));
+	BenchReaderArgs* args = malloc((size_t)readerCount * sizeof(BenchReaderArgs));
+	if (NULL == threads || NULL == args) {
+		free(threads);
+		free(args);
+		return;
+	}
+	const char* names[3] = { "locked", "optimistic", "cow" };
+	for (int mode = 0; mode < 3; mode++) {
+		int persistent = (2 == mode);
+		RBTree* tree = persistent ? NULL : RBTree_createWithArena(intCompare, 0);
+		RBPersistentTree* persistentTree = persistent ? RBPersistentTree_create(intCompare) : NULL;
+		atomic_int writing;
+		atomic_init(&writing, 1);
+		for (int t = 0; t < readerCount; t++) {
+			args[t] = (BenchReaderArgs){ tree, persistentTree, 1 == mode, keys, n, &writing, 0 };
+			pthread_create(&threads[t], NULL, Bench_readerWorker, &args[t]);
+		}
+		double start = Bench_now();
+		for (int i = 0; i < n; i++) {
+			if (persistent) {
+				RBPersistentTree_insert(persistentTree, &keys[i], &keys[i]);
+			} else {
+				Par_RBTree_insert(tree, &keys[i], &keys[i]);
+			}
+		}
+		double finished = Bench_now();
+		atomic_store(&writing, 0);
+		long lookups = 0;
+		for (int t = 0; t < readerCount; t++) {
+			pthread_join(threads[t], NULL);
+			lookups += args[t].lookups;
+		}
+		RBTree_delete(tree);
+		RBPersistentTree_delete(persistentTree);
+
+		char label[64];
+		snprintf(label, sizeof(label), "%s write", names[mode]);
+		Bench_report(label, n, finished - start);
+		snprintf(label, sizeof(label), "%s read", names[mode]);
+		printf("%-24s %d readers %10.2f Mlookups/s\n", label, readerCount, lookups / (finished - start) / 1e6);
+	}
+	free(threads);
+	free(args);
+}
+
+#define BENCH_FROZEN_LOOKUPS 1000000		// Lookups timed at each frozen size
+
+void Bench_frozen(int* keys, int n) {
+	// Tree search against the frozen layouts, at every power of ten from 10K up to n keys
+	int* sortedKeys = malloc((size_t)n * sizeof(int));
+	void** keyPtrs = malloc((size_t)n * sizeof(void*));
+	if (NULL == sortedKeys || NULL == keyPtrs) {
+		free(sortedKeys);
+		free(keyPtrs);
+		return;
+	}
+	for (long size = 10000; size <= n; size *= 10) {
+		memcpy(sortedKeys, keys, (size_t)size * sizeof(int));
+		qsort(sortedKeys, (size_t)size, sizeof(int), Bench_intAscending);
+		for (int i = 0; i < size; i++) {
+			keyPtrs[i] = &sortedKeys[i];
+		}
+		RBTree* tree = RBTree_buildFromSorted(keyPtrs, keyPtrs, (int)size, intCompare);
+		RBFrozenTree* frozen = RBTree_freeze(tree);
+		RBFrozenTree* frozenInt = RBTree_freezeInt(tree);
+		long found = 0;
+		double start = Bench_now();
+		for (int i = 0; i < BENCH_FROZEN_LOOKUPS; i++) {
+			found += (NULL != RBTree_search(tree, &keys[i % size]));
+		}
+		double searched = Bench_now();
+		for (int i = 0; i < BENCH_FROZEN_LOOKUPS; i++) {
+			found += (NULL != RBFrozenTree_search(frozen, &keys[i % size]));
+		}
+		double frozenSearched = Bench_now();
+		for (int i = 0; i < BENCH_FROZEN_LOOKUPS; i++) {
+			found += (NULL != RBFrozenTree_search(frozenInt, &keys[i % size]));
+		}
+		double intSearched = Bench_now();
+		RBFrozenTree_delete(frozen);
+		RBFrozenTree_delete(frozenInt);
+		RBTree_delete(tree);
+
+		char label[64];
+		snprintf(label, sizeof(label), "tree search %ld", size);
+		Bench_report(label, BENCH_FROZEN_LOOKUPS, searched - start);
+		snprintf(label, sizeof(label), "eytzinger search %ld", size);
+		Bench_report(label, BENCH_FROZEN_LOOKUPS, frozenSearched - searched);
+		snprintf(label, sizeof(label), "simd block search %ld", size);
+		Bench_report(label, BENCH_FROZEN_LOOKUPS, intSearched - frozenSearched);
+		if (3 * BENCH_FROZEN_LOOKUPS != found) {
+			printf("frozen lookups missed keys\n");
+		}
+	}
+	free(sortedKeys);
+	free(keyPtrs);
+}
+
+void Bench_btree(int* keys, int n) {
+	// The red-black tree against both B-tree modes on the same keys
+	const char* names[3] = { "rbtree", "btree", "btree int" };
+	for (int mode = 0; mode < 3; mode++) {
+		RBTree* tree = (0 == mode) ? RBTree_createWithArena(intCompare, 0) : NULL;
+		BTree* btree = (1 == mode) ? BTree_create(intCompare) : (2 == mode) ? BTree_createInt() : NULL;
+		double start = Bench_now();
+		for (int i = 0; i < n; i++) {
+			if (NULL != tree) {
+				RBTree_insert(tree, &keys[i], &keys[i]);
+			} else {
+				BTree_insert(btree, &keys[i], &keys[i]);
+			}
+		}
+		double inserted = Bench_now();
+		long found = 0;
+		for (int i = 0; i < n; i++) {
+			found += (NULL != ((NULL != tree) ? RBTree_search(tree, &keys[i]) : BTree_search(btree, &keys[i])));
+		}
+		double searched = Bench_now();
+		long sum = 0;
+		if (NULL != tree) {
+			RBTree_forEach(tree, Bench_sumKeys, &sum);
+		} else {
+			BTreeIterator iter;
+			BTreeIterator_init(&iter, btree);
+			while (BTreeIterator_hasNext(&iter)) {
+				BTreeIterator_getNext(&iter);
+				sum += *(int*)BTreeIterator_getKey(&iter);
+			}
+		}
+		double scanned = Bench_now();
+		RBTree_delete(tree);
+		BTree_delete(btree);
+
+		char label[64];
+		snprintf(label, sizeof(label), "%s insert", names[mode]);
+		Bench_report(label, n, inserted - start);
+		snprintf(label, sizeof(label), "%s search", names[mode]);
+		Bench_report(label, n, searched - inserted);
+		snprintf(label, sizeof(label), "%s scan", names[mode]);
+		Bench_report(label, n, scanned - searched);
+		if (n != found || 0 == sum) {
+			printf("\n");
+		}
+	}
+}
+
+#define BENCH_GROUP_SIZE 64					// Values per key in the multimap runs
+
+void Bench_multimap(int* keys, int n) {
+	// Grouped keys as extra nodes against one node per key holding a value list
+	int* groupKeys = malloc((size_t)n * sizeof(int));
+	if (NULL == groupKeys) {
+		return;
+	}
+	for (int i = 0; i < n; i++) {
+		groupKeys[i] = keys[i / BENCH_GROUP_SIZE];
+	}
+	for (int multimap = 0; multimap < 2; multimap++) {
+		RBTree* tree = RBTree_createWithArena(intCompare, 0);
+		RBTree_setMultimap(tree, multimap);
+		double start = Bench_now();
+		for (int i = 0; i < n; i++) {
+			RBTree_insert(tree, &groupKeys[i], &keys[i]);
+		}
+		double inserted = Bench_now();
+		long found = 0;
+		for (int i = 0; i < n; i++) {
+			found += (NULL != RBTree_search(tree, &groupKeys[i]));
+		}
+		double searched = Bench_now();
+		int nodes = RBTree_size(tree);
+		RBTree_delete(tree);
+
+		Bench_report(multimap ? "multimap insert" : "duplicates insert", n, inserted - start);
+		Bench_report(multimap ? "multimap search" : "duplicates search", n, searched - inserted);
+		printf("%-24s %d nodes\n", multimap ? "multimap tree" : "duplicates tree", nodes);
+		if (n != found) {
+			printf("\n");
+		}
+	}
+	free(groupKeys);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START Bench SUITE
+//
+////////////////////////////////////////////////////////////////////////////////
+
+typedef enum Bench_Distribution {
+	BENCH_RANDOM,
+	BENCH_SORTED,
+	BENCH_REVERSE,
+	BENCH_ZIPF,
+	BENCH_DUPLICATES,
+	BENCH_DISTRIBUTIONS,
+} BenchDistribution;
+
+const char* Bench_distributionNames[BENCH_DISTRIBUTIONS] = {"random", "sorted", "reverse", "zipf", "duplicates"};
+
+typedef enum Bench_Format {
+	BENCH_TEXT,
+	BENCH_CSV,
+	BENCH_JSON,
+} BenchFormat;
+
+typedef struct Bench_Result {
+	const char* distribution;				// Name of the key distribution
+	const char* operation;					// insert, search, scan or delete
+	int size;								// Keys in the tree
+	long ops;								// Operations timed
+	double seconds;							// Wall time of all operations
+	double percentiles[4];					// p50, p90, p99 and p99.9 in ns, negative when not sampled
+	long peakRssKb;							// Peak resident set of the process so far
+	long treeRssKb;							// Resident set added by building the tree
+} BenchResult;
+
+typedef struct Bench_Sampler {
+	double* samples;						// Nanoseconds taken by each sampled operation
+	long count;								// Samples taken
+	long capacity;							// Room in samples
+	int stride;								// Every stride-th operation is timed on its own
+} BenchSampler;
+
+int Bench_compareIntAscending(const void* a, const void* b) {
+	int x = *(const int*)a;
+	int y = *(const int*)b;
+	return (x > y) - (x < y);
+}
+
+int Bench_compareDoubles(const void* a, const void* b) {
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+unsigned int Bench_scramble(unsigned long rank) {
+	// Spreads zipf ranks over the key space so the hot keys are not also the smallest
+	rank ^= rank >> 33;
+	rank *= 0xff51afd7ed558ccdUL;
+	rank ^= rank >> 33;
+	return (unsigned int)rank & INT_MAX;
+}
+
+int* Bench_zipfKeys(int n, unsigned int seed) {
+	// Rank generator of Gray et al., as used by YCSB, with skew 0.99 over n distinct ranks
+	const double theta = 0.99;
+	int* keys = malloc((size_t)n * sizeof(int));
+	if (NULL == keys) {
+		return NULL;
+	}
+	double zetan = 0;
+	for (int i = 1; i <= n; i++) {
+		zetan += 1 / pow(i, theta);
+	}
+	double zeta2 = 1 + 1 / pow(2, theta);
+	double alpha = 1 / (1 - theta);
+	double eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+	srand(seed);
+	for (int i = 0; i < n; i++) {
+		double u = (double)rand() / ((double)RAND_MAX + 1);
+		double uz = u * zetan;
+		unsigned long rank;
+		if (uz < 1) {
+			rank = 0;
+		} else if (uz < zeta2) {
+			rank = 1;
+		} else {
+			rank = (unsigned long)(n * pow(eta * u - eta + 1, alpha));
+		}
+		keys[i] = (int)Bench_scramble(rank);
+	}
+	return keys;
+}
+
+int* Bench_distributionKeys(BenchDistribution distribution, int n, unsigned int seed) {
+	if (BENCH_ZIPF == distribution) {
+		return Bench_zipfKeys(n, seed);
+	}
+	int* keys = Bench_randomKeys(n, seed);
+	if (NULL == keys) {
+		return NULL;
+	}
+	if (BENCH_SORTED == distribution || BENCH_REVERSE == distribution) {
+		qsort(keys, n, sizeof(int), Bench_compareIntAscending);
+	}
+	if (BENCH_REVERSE == distribution) {
+		for (int i = 0, j = n - 1; i < j; i++, j--) {
+			int swap = keys[i];
+			keys[i] = keys[j];
+			keys[j] = swap;
+		}
+	}
+	if (BENCH_DUPLICATES == distribution) {
+		// About a hundred copies of every distinct key
+		int distinct = (100 < n) ? n / 100 : 1;
+		for (int i = 0; i < n; i++) {
+			keys[i] %= distinct;
+		}
+	}
+	return keys;
+}
+
+long Bench_peakRssKb() {
+	struct rusage usage;
+	if (0 != getrusage(RUSAGE_SELF, &usage)) {
+		return 0;
+	}
+	return usage.ru_maxrss;
+}
+
+long Bench_currentRssKb() {
+	// Resident pages from /proc, or 0 where it does not exist
+	long pages = 0;
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if (NULL == statm) {
+		return 0;
+	}
+	if (1 != fscanf(statm, "%*s %ld", &pages)) {
+		pages = 0;
+	}
+	fclose(statm);
+	return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+int Bench_initSampler(BenchSampler* sampler, int n) {
+	// At least 16 operations per timed one keeps the clock reads out of the throughput
+	sampler->stride = (16 < n / 65536) ? n / 65536 : 16;
+	sampler->capacity = n / sampler->stride + 1;
+	sampler->count = 0;
+	sampler->samples = malloc((size_t)sampler->capacity * sizeof(double));
+	return (NULL == sampler->samples) ? 1 : 0;
+}
+
+void Bench_finishSampler(BenchSampler* sampler, BenchResult* result) {
+	static const double ranks[4] = {0.50, 0.90, 0.99, 0.999};
+	qsort(sampler->samples, sampler->count, sizeof(double), Bench_compareDoubles);
+	for (int i = 0; i < 4; i++) {
+		result->percentiles[i] = (0 < sampler->count)
+			? sampler->samples[(long)(ranks[i] * (sampler->count - 1))] : -1;
+	}
+	sampler->count = 0;
+}
+
+void Bench_emit(BenchFormat format, BenchResult* result, int first) {
+	double nsPerOp = result->seconds * 1e9 / result->ops;
+	double mopsPerSec = result->ops / result->seconds / 1e6;
+	if (BENCH_TEXT == format) {
+		printf("%-10s %-7s n=%-10d %8.1f ns/op %8.2f Mops/s", result->distribution, result->operation,
+			result->size, nsPerOp, mopsPerSec);
+		if (0 <= result->percentiles[0]) {
+			printf("  p50 %6.0f  p90 %6.0f  p99 %6.0f  p99.9 %7.0f ns", result->percentiles[0],
+				result->percentiles[1], result->percentiles[2], result->percentiles[3]);
+		}
+		printf("  peak %ld KB  tree %ld KB\n", result->peakRssKb, result->treeRssKb);
+	} else if (BENCH_CSV == format) {
+		if (first) {
+			printf("size,distribution,operation,ops,ns_per_op,mops_per_s,p50_ns,p90_ns,p99_ns,p999_ns,"
+				"peak_rss_kb,tree_rss_kb\n");
+		}
+		printf("%d,%s,%s,%ld,%.2f,%.4f", result->size, result->distribution, result->operation, result->ops,
+			nsPerOp, mopsPerSec);
+		for (int i = 0; i < 4; i++) {
+			if (0 <= result->percentiles[i]) {
+				printf(",%.0f", result->percentiles[i]);
+			} else {
+				printf(",");
+			}
+		}
+		printf(",%ld,%ld\n", result->peakRssKb, result->treeRssKb);
+	} else {
+		static const char* names[4] = {"p50_ns", "p90_ns", "p99_ns", "p999_ns"};
+		printf("%s\n  {\"size\": %d, \"distribution\": \"%s\", \"operation\": \"%s\", \"ops\": %ld, "
+			"\"ns_per_op\": %.2f, \"mops_per_s\": %.4f", first ? "[" : ",", result->size, result->distribution,
+			result->operation, result->ops, nsPerOp, mopsPerSec);
+		for (int i = 0; i < 4; i++) {
+			if (0 <= result->percentiles[i]) {
+				printf(", \"%s\": %.0f", names[i], result->percentiles[i]);
+			} else {
+				printf(", \"%s\": null", names[i]);
+			}
+		}
+		printf(", \"peak_rss_kb\": %ld, \"tree_rss_kb\": %ld}", result->peakRssKb, result->treeRssKb);
+	}
+	fflush(stdout);
+}
+
+int Bench_case(BenchDistribution distribution, int n, int useArena, BenchFormat format, int first) {
+	// Insert, search, scan and delete one tree of n keys, emitting a result per phase
+	int* keys = Bench_distributionKeys(distribution, n, 42);
+	BenchSampler sampler;
+	if (NULL == keys || 0 != Bench_initSampler(&sampler, n)) {
+		free(keys);
+		return 1;
+	}
+	BenchResult result = {Bench_distributionNames[distribution], "insert", n, n, 0, {0}, 0, 0};
+	long baseRss = Bench_currentRssKb();
+	RBTree* tree = useArena ? RBTree_createWithArena(intCompare, 0) : RBTree_create(intCompare);
+	if (NULL == tree) {
+		free(sampler.samples);
+		free(keys);
+		return 1;
+	}
+
+	double start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		if (0 == i % sampler.stride) {
+			double before = Bench_now();
+			RBTree_insert(tree, &keys[i], &keys[i]);
+			sampler.samples[sampler.count++] = (Bench_now() - before) * 1e9;
+		} else {
+			RBTree_insert(tree, &keys[i], &keys[i]);
+		}
+	}
+	result.seconds = Bench_now() - start;
+	result.treeRssKb = Bench_currentRssKb() - baseRss;
+	result.peakRssKb = Bench_peakRssKb();
+	Bench_finishSampler(&sampler, &result);
+	Bench_emit(format, &result, first);
+
+	// Lookups in insertion order, so zipf and duplicate runs keep their hot keys
+	long found = 0;
+	start = Bench_now();
+	for (int i = 0; i < n; i++) {
+		if (0 == i % sampler.stride) {
+			double before = Bench_now();
+			found += (NULL != RBTree_search(tree, &keys[i]));
+			sampler.samples[sampler.count++] = (Bench_now() - before) * 1e9;
+		} else {
+			found += (NULL != RBTree_search(tree, &keys[i]));
+		}
+	}
+	result.operation = "search";
+	result.seconds = Bench_now() - start;
+	Bench_finishSampler(&sampler, &result);
+	Bench_emit(format, &result, 0);
+
+	long sum = 0;
+	long visited = 0;
+	RBTreeIterator iter;
+	start = Bench_now();
+	RBTreeIterator_init(&iter, tree);
+	while (RBTreeIterator_hasNext(&iter)) {
+		if (0 == visited % sampler.stride) {
+			double before = Bench_now();
+			RBTreeIterator_getNext(&iter);
+			sampler.samples[sampler.count++] = (Bench_now() - before) * 1e9;
+		} else {
+			RBTreeIterator_getNext(&iter);
+		}
+		sum += *(int*)RBTreeIterator_getKey(&iter);
+		visited++;
+	}
+	result.operation = "scan";
+	result.seconds = Bench_now() - start;
+	Bench_finishSampler(&sampler, &result);
+	Bench_emit(format, &result, 0);
+
+	// Teardown is one call, so it is reported per node without percentiles
+	start = Bench_now();
+	RBTree_delete(tree);
+	result.operation = "delete";
+	result.seconds = Bench_now() - start;
+	for (int i = 0; i < 4; i++) {
+		result.percentiles[i] = -1;
+	}
+	Bench_emit(format, &result, 0);
+
+	free(sampler.samples);
+	free(keys);
+#ifdef __GLIBC__
+	// Hands freed nodes back to the system so the next case measures its own resident set
+	malloc_trim(0);
+#endif
+	if (n != found || n != visited || -1 == sum) {
+		fprintf(stderr, "%s n=%d: found %ld, visited %ld\n", result.distribution, n, found, visited);
+		return 1;
+	}
+	return 0;
+}
+
+int Bench_parseSizes(char* list, int* sizes, int capacity) {
+	// Comma-separated key counts, each with an optional K or M suffix; returns how many were read
+	int count = 0;
+	for (char* token = strtok(list, ","); NULL != token && count < capacity; token = strtok(NULL, ",")) {
+		char* end;
+		long size = strtol(token, &end, 10);
+		if ('k' == *end || 'K' == *end) {
+			size *= 1000;
+			end++;
+		} else if ('m' == *end || 'M' == *end) {
+			size *= 1000000;
+			end++;
+		}
+		if ('\0' != *end || 0 >= size || INT_MAX < size) {
+			return 0;
+		}
+		sizes[count++] = (int)size;
+	}
+	return count;
+}
+
+int Bench_parseDistributions(char* list, int* enabled) {
+	int count = 0;
+	for (char* token = strtok(list, ","); NULL != token; token = strtok(NULL, ",")) {
+		int d = 0;
+		while (d < BENCH_DISTRIBUTIONS && 0 != strcmp(token, Bench_distributionNames[d])) {
+			d++;
+		}
+		if (BENCH_DISTRIBUTIONS == d) {
+			return 0;
+		}
+		enabled[d] = 1;
+		count++;
+	}
+	return count;
+}
+
+void Bench_features(int n, int maxThreads) {
+	int* keys = Bench_randomKeys(n, 42);
+	if (NULL == keys) {
+		return;
+	}
+	Bench_insertDelete("malloc", RBTree_create(intCompare), keys, n);
+	Bench_insertDelete("arena", RBTree_createWithArena(intCompare, 0), keys, n);
+	Bench_buildFromSorted(keys, n);
+	Bench_typed(keys, n);
+	Bench_batches(keys, n);
+	Bench_searchBatch(keys, n);
+	Bench_churn(keys, n);
+	Bench_union(keys, n, maxThreads);
+	Bench_upsert(keys, n);
+	Bench_scan(keys, n);
+	Bench_parallelScan(keys, n, maxThreads);
+	Bench_teardown(keys, n);
+	Bench_snapshot(keys, n);
+	Bench_frozen(keys, n);
+	Bench_btree(keys, n);
+	Bench_multimap(keys, n);
+	Bench_parallel(keys, n, maxThreads, 0);
+	Bench_parallel(keys, n, maxThreads, 10);
+	Bench_sharded(keys, n, maxThreads);
+	Bench_readersWithWriter(keys, n, maxThreads);
+	free(keys);
+}
+
+void Bench_usage(const char* name) {
+	fprintf(stderr,
+		"usage: %s [-s sizes] [-d distributions] [-f text|csv|json] [-a] [-x keys] [-t threads]\n"
+		"  -s  comma-separated key counts, K and M suffixes allowed (default 1K,10K,100K,1M)\n"
+		"  -d  any of random,sorted,reverse,zipf,duplicates (default all)\n"
+		"  -f  output format (default text)\n"
+		"  -a  take nodes from an arena instead of malloc\n"
+		"  -x  run the feature benchmarks over this many random keys instead of the suite\n"
+		"  -t  largest thread count for the parallel feature benchmarks\n", name);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START Bench MAIN
+//
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char** argv) {
+	int sizes[BENCH_MAX_SIZES] = {1000, 10000, 100000, 1000000};
+	int sizeCount = 4;
+	int enabled[BENCH_DISTRIBUTIONS] = {0};
+	int distributionCount = 0;
+	BenchFormat format = BENCH_TEXT;
+	int useArena = 0;
+	int featureKeys = 0;
+	int maxThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int option;
+	while (-1 != (option = getopt(argc, argv, "s:d:f:ax:t:"))) {
+		switch (option) {
+		case 's':
+			sizeCount = Bench_parseSizes(optarg, sizes, BENCH_MAX_SIZES);
+			break;
+		case 'd':
+			distributionCount = Bench_parseDistributions(optarg, enabled);
+			if (0 == distributionCount) {
+				distributionCount = -1;
+			}
+			break;
+		case 'f':
+			format = (0 == strcmp(optarg, "csv")) ? BENCH_CSV : (0 == strcmp(optarg, "json")) ? BENCH_JSON
+				: (0 == strcmp(optarg, "text")) ? BENCH_TEXT : -1;
+			break;
+		case 'a':
+			useArena = 1;
+			break;
+		case 'x':
+			featureKeys = atoi(optarg);
+			if (0 >= featureKeys) {
+				featureKeys = -1;
+			}
+			break;
+		case 't':
+			maxThreads = atoi(optarg);
+			break;
+		default:
+			Bench_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (0 == sizeCount || 0 > distributionCount || 0 > (int)format || 0 > featureKeys || optind < argc) {
+		Bench_usage(argv[0]);
+		return 1;
+	}
+	if (0 >= maxThreads) {
+		maxThreads = 1;
+	}
+	if (0 < featureKeys) {
+		Bench_features(featureKeys, maxThreads);
+		return 0;
+	}
+	if (0 == distributionCount) {
+		for (int d = 0; d < BENCH_DISTRIBUTIONS; d++) {
+			enabled[d] = 1;
+		}
+	}
+
+	int failed = 0;
+	int first = 1;
+	for (int s = 0; s < sizeCount; s++) {
+		for (int d = 0; d < BENCH_DISTRIBUTIONS; d++) {
+			if (enabled[d]) {
+				failed |= Bench_case(d, sizes[s], useArena, format, first);
+				first = 0;
+			}
+		}
+	}
+	if (BENCH_JSON == format) {
+		printf("\n]\n");
+	}
+	return failed;
+}
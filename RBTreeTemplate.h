@@ -0,0 +1,455 @@
+// RBTreeTemplate.h
+// Type-specialized Red-Black Trees generated by macro.
+//
+// RBTREE_DEFINE(prefix, KeyT, ValT, CMP_EXPR) emits a tree whose nodes hold the
+// key and value inline and whose comparisons are expanded in place instead of
+// going through a Comparator. CMP_EXPR(a, b) follows the Comparator convention
+// of RBTree.c: positive when a < b, zero when equal, negative when a > b.
+//
+//     RBTREE_DEFINE(IntTree, int, int, RBTREE_CMP_NUMERIC)
+//
+//     IntTree* tree = IntTree_create();
+//     IntTree_insert(tree, 4, 16);
+//     int* value = IntTree_search(tree, 4);
+//     IntTree_delete(tree);
+//
+// RBTREE_DEFINE_INDEXED(prefix, KeyT, ValT, CMP_EXPR) emits the same interface, plus
+// prefix_reserve, over nodes kept in one growable array and linked by 32-bit indices.
+// The color shares a word with the parent index, so a node costs 12 bytes plus its
+// key and value. Inserting may move the array, so pointers from prefix_search only
+// stay valid until the next insert.
+
+#ifndef RBTREE_TEMPLATE_H
+#define RBTREE_TEMPLATE_H
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START PREPROCESSOR DIRECTIVES
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define RBTREE_CMP_NUMERIC(a, b) (((a) < (b)) - ((a) > (b)))
+
+#define RBTREE_NIL 0						// Index of the sentinel that stands in for NULL
+#define RBTREE_INDEX_MAX 0x7FFFFFFFu		// Parent indices give up their low bit to the color
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTREE_DEFINE
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define RBTREE_DEFINE(prefix, KeyT, ValT, CMP_EXPR)															\
+																											\
+typedef struct prefix##_Node {																				\
+	struct prefix##_Node* parent;			/* Parent of this node */										\
+	struct prefix##_Node* children[2];		/* Children of this node */										\
+	KeyT key;								/* The key of this node */										\
+	ValT value;								/* The value of this node */									\
+	unsigned char red;						/* 1 when RED, 0 when BLACK */									\
+} prefix##Node;																								\
+																											\
+typedef struct prefix {																						\
+	prefix##Node* root;						/* The root of the tree */										\
+} prefix;																									\
+																											\
+typedef struct prefix##_Iterator {																			\
+	prefix##Node* currNode;					/* Current node */												\
+	prefix##Node* nextNode;					/* Next node to iterate to */									\
+} prefix##Iterator;																							\
+																											\
+static inline prefix* prefix##_create(void) {																\
+	prefix* newTree = malloc(sizeof(prefix));																\
+	if (NULL == newTree) {																					\
+		return NULL;																						\
+	}																										\
+	newTree->root = NULL;																					\
+	return newTree;																							\
+}																											\
+																											\
+static inline void prefix##_deleteNodes(prefix##Node* node) {											\
+	/* Rotates left children up so each node is freed once without a stack */								\
+	while (NULL != node) {																					\
+		prefix##Node* leftChild = node->children[0];															\
+		if (NULL != leftChild) {																				\
+			node->children[0] = leftChild->children[1];														\
+			leftChild->children[1] = node;																		\
+			node = leftChild;																					\
+			continue;																							\
+		}																										\
+		prefix##Node* nextNode = node->children[1];															\
+		free(node);																								\
+		node = nextNode;																						\
+	}																											\
+}																											\
+																											\
+static inline void prefix##_delete(prefix* tree) {															\
+	if (NULL != tree) {																						\
+		prefix##_deleteNodes(tree->root);																\
+		free(tree);																							\
+	}																										\
+}																											\
+																											\
+static inline void prefix##_rotate(prefix* tree, prefix##Node* node, int dir) {							\
+	/* dir 0 rotates left, dir 1 rotates right */															\
+	prefix##Node* newParent = node->children[1 - dir];														\
+	node->children[1 - dir] = newParent->children[dir];														\
+	if (NULL != newParent->children[dir]) {																	\
+		newParent->children[dir]->parent = node;															\
+	}																										\
+	newParent->parent = node->parent;																		\
+	if (NULL == node->parent) {																				\
+		tree->root = newParent;																				\
+	} else {																								\
+		node->parent->children[node == node->parent->children[1]] = newParent;							\
+	}																										\
+	newParent->children[dir] = node;																		\
+	node->parent = newParent;																				\
+}																											\
+																											\
+static inline void prefix##_repairAfterInsert(prefix* tree, prefix##Node* node) {							\
+	while (NULL != node->parent && node->parent->red) {														\
+		prefix##Node* parent = node->parent;																\
+		prefix##Node* grandparent = parent->parent;															\
+		int side = (parent == grandparent->children[1]);													\
+		prefix##Node* uncle = grandparent->children[1 - side];												\
+		if (NULL != uncle && uncle->red) {																	\
+			parent->red = 0;																				\
+			uncle->red = 0;																					\
+			grandparent->red = 1;																			\
+			node = grandparent;																				\
+		} else {																							\
+			if (node == parent->children[1 - side]) {														\
+				node = parent;																				\
+				prefix##_rotate(tree, node, side);															\
+				parent = node->parent;																		\
+			}																								\
+			parent->red = 0;																				\
+			grandparent->red = 1;																			\
+			prefix##_rotate(tree, grandparent, 1 - side);													\
+		}																									\
+	}																										\
+	tree->root->red = 0;																					\
+}																											\
+																											\
+static inline int prefix##_insert(prefix* tree, KeyT key, ValT value) {									\
+	if (NULL == tree) {																						\
+		return 1;																							\
+	}																										\
+	prefix##Node* currTreeParent = NULL;																	\
+	prefix##Node* currTreeNode = tree->root;																\
+	int dir = 0;																							\
+	/* Equal keys go right, as in RBTree_insert */															\
+	while (NULL != currTreeNode) {																			\
+		currTreeParent = currTreeNode;																		\
+		dir = (0 <= CMP_EXPR(currTreeNode->key, key));														\
+		currTreeNode = currTreeNode->children[dir];															\
+	}																										\
+	prefix##Node* newNode = malloc(sizeof(prefix##Node));													\
+	if (NULL == newNode) {																					\
+		return 1;																							\
+	}																										\
+	newNode->parent = currTreeParent;																		\
+	newNode->children[0] = NULL;																			\
+	newNode->children[1] = NULL;																			\
+	newNode->key = key;																						\
+	newNode->value = value;																					\
+	newNode->red = 1;																						\
+	if (NULL == currTreeParent) {																			\
+		tree->root = newNode;																				\
+	} else {																								\
+		currTreeParent->children[dir] = newNode;															\
+	}																										\
+	prefix##_repairAfterInsert(tree, newNode);																\
+	return 0;																								\
+}																											\
+																											\
+static inline ValT* prefix##_search(prefix* tree, KeyT key) {												\
+	if (NULL == tree) {																						\
+		return NULL;																						\
+	}																										\
+	prefix##Node* currNode = tree->root;																	\
+	while (NULL != currNode) {																				\
+		int order = CMP_EXPR(currNode->key, key);															\
+		if (0 == order) {																					\
+			return &currNode->value;																		\
+		}																									\
+		currNode = currNode->children[0 > order ? 0 : 1];													\
+	}																										\
+	return NULL;																							\
+}																											\
+																											\
+static inline void prefix##Iterator_init(prefix##Iterator* iter, prefix* tree) {							\
+	iter->currNode = NULL;																					\
+	iter->nextNode = (NULL == tree) ? NULL : tree->root;													\
+	while (NULL != iter->nextNode && NULL != iter->nextNode->children[0]) {									\
+		iter->nextNode = iter->nextNode->children[0];														\
+	}																										\
+}																											\
+																											\
+static inline int prefix##Iterator_hasNext(prefix##Iterator* iter) {										\
+	return (NULL == iter->nextNode) ? 0 : 1;																\
+}																											\
+																											\
+static inline void prefix##Iterator_getNext(prefix##Iterator* iter) {										\
+	iter->currNode = iter->nextNode;																		\
+	if (NULL == iter->currNode) {																			\
+		return;																								\
+	}																										\
+	if (NULL != iter->currNode->children[1]) {																\
+		iter->nextNode = iter->currNode->children[1];														\
+		while (NULL != iter->nextNode->children[0]) {														\
+			iter->nextNode = iter->nextNode->children[0];													\
+		}																									\
+	} else {																								\
+		prefix##Node* n = iter->currNode;																	\
+		prefix##Node* p = n->parent;																		\
+		while (NULL != p && n == p->children[1]) {															\
+			n = p;																							\
+			p = p->parent;																					\
+		}																									\
+		iter->nextNode = p;																					\
+	}																										\
+}																											\
+																											\
+static inline KeyT prefix##Iterator_getKey(prefix##Iterator* iter) {										\
+	return iter->currNode->key;																				\
+}																											\
+																											\
+static inline ValT* prefix##Iterator_getValue(prefix##Iterator* iter) {									\
+	return &iter->currNode->value;																			\
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// START RBTREE_DEFINE_INDEXED
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define RBTREE_DEFINE_INDEXED(prefix, KeyT, ValT, CMP_EXPR)														\
+																											\
+typedef struct prefix##_Node {																				\
+	uint32_t parent;						/* Index of the parent shifted left once, low bit 1 when RED */	\
+	uint32_t children[2];					/* Indices of the children, RBTREE_NIL when absent */			\
+	KeyT key;								/* The key of this node */										\
+	ValT value;								/* The value of this node */									\
+} prefix##Node;																								\
+																											\
+typedef struct prefix {																						\
+	prefix##Node* nodes;					/* All nodes, slot RBTREE_NIL is a black sentinel */			\
+	uint32_t root;							/* Index of the root of the tree */								\
+	uint32_t count;							/* Slots in use, including the sentinel */						\
+	uint32_t capacity;						/* Slots allocated */											\
+} prefix;																									\
+																											\
+typedef struct prefix##_Iterator {																			\
+	prefix* tree;							/* Tree to iterate on */										\
+	uint32_t currNode;						/* Current node */												\
+	uint32_t nextNode;						/* Next node to iterate to */									\
+} prefix##Iterator;																							\
+																											\
+static inline uint32_t prefix##_getParent(prefix* tree, uint32_t node) {									\
+	return tree->nodes[node].parent >> 1;																	\
+}																											\
+																											\
+static inline int prefix##_isRed(prefix* tree, uint32_t node) {											\
+	return (int)(tree->nodes[node].parent & 1);																\
+}																											\
+																											\
+static inline void prefix##_setParent(prefix* tree, uint32_t node, uint32_t parent) {						\
+	tree->nodes[node].parent = (parent << 1) | (tree->nodes[node].parent & 1);								\
+}																											\
+																											\
+static inline void prefix##_setRed(prefix* tree, uint32_t node, int red) {									\
+	tree->nodes[node].parent = (tree->nodes[node].parent & ~1u) | (red ? 1u : 0u);							\
+}																											\
+																											\
+static inline int prefix##_reserve(prefix* tree, uint32_t capacity) {										\
+	if (NULL == tree || RBTREE_INDEX_MAX < capacity) {														\
+		return 1;																							\
+	}																										\
+	if (capacity <= tree->capacity) {																		\
+		return 0;																							\
+	}																										\
+	prefix##Node* nodes = realloc(tree->nodes, (size_t)capacity * sizeof(prefix##Node));					\
+	if (NULL == nodes) {																					\
+		return 1;																							\
+	}																										\
+	tree->nodes = nodes;																					\
+	tree->capacity = capacity;																				\
+	return 0;																								\
+}																											\
+																											\
+static inline prefix* prefix##_create(void) {																\
+	prefix* newTree = malloc(sizeof(prefix));																\
+	if (NULL == newTree) {																					\
+		return NULL;																						\
+	}																										\
+	newTree->nodes = NULL;																					\
+	newTree->root = RBTREE_NIL;																				\
+	newTree->count = 0;																						\
+	newTree->capacity = 0;																					\
+	if (0 != prefix##_reserve(newTree, 16)) {																\
+		free(newTree);																						\
+		return NULL;																						\
+	}																										\
+	/* The sentinel is black and never written by rotations */												\
+	newTree->nodes[RBTREE_NIL].parent = 0;																	\
+	newTree->nodes[RBTREE_NIL].children[0] = RBTREE_NIL;													\
+	newTree->nodes[RBTREE_NIL].children[1] = RBTREE_NIL;													\
+	newTree->count = 1;																						\
+	return newTree;																							\
+}																											\
+																											\
+static inline void prefix##_delete(prefix* tree) {															\
+	if (NULL != tree) {																						\
+		free(tree->nodes);																					\
+		free(tree);																							\
+	}																										\
+}																											\
+																											\
+static inline void prefix##_rotate(prefix* tree, uint32_t node, int dir) {									\
+	/* dir 0 rotates left, dir 1 rotates right */															\
+	prefix##Node* nodes = tree->nodes;																		\
+	uint32_t newParent = nodes[node].children[1 - dir];														\
+	uint32_t parent = prefix##_getParent(tree, node);														\
+	nodes[node].children[1 - dir] = nodes[newParent].children[dir];											\
+	if (RBTREE_NIL != nodes[newParent].children[dir]) {														\
+		prefix##_setParent(tree, nodes[newParent].children[dir], node);									\
+	}																										\
+	prefix##_setParent(tree, newParent, parent);															\
+	if (RBTREE_NIL == parent) {																				\
+		tree->root = newParent;																				\
+	} else {																								\
+		nodes[parent].children[node == nodes[parent].children[1]] = newParent;								\
+	}																										\
+	nodes[newParent].children[dir] = node;																	\
+	prefix##_setParent(tree, node, newParent);																\
+}																											\
+																											\
+static inline void prefix##_repairAfterInsert(prefix* tree, uint32_t node) {								\
+	prefix##Node* nodes = tree->nodes;																		\
+	while (RBTREE_NIL != prefix##_getParent(tree, node) && prefix##_isRed(tree, prefix##_getParent(tree, node))) {	\
+		uint32_t parent = prefix##_getParent(tree, node);													\
+		uint32_t grandparent = prefix##_getParent(tree, parent);											\
+		int side = (parent == nodes[grandparent].children[1]);												\
+		uint32_t uncle = nodes[grandparent].children[1 - side];												\
+		if (prefix##_isRed(tree, uncle)) {																	\
+			prefix##_setRed(tree, parent, 0);																\
+			prefix##_setRed(tree, uncle, 0);																\
+			prefix##_setRed(tree, grandparent, 1);															\
+			node = grandparent;																				\
+		} else {																							\
+			if (node == nodes[parent].children[1 - side]) {													\
+				node = parent;																				\
+				prefix##_rotate(tree, node, side);															\
+				parent = prefix##_getParent(tree, node);													\
+			}																								\
+			prefix##_setRed(tree, parent, 0);																\
+			prefix##_setRed(tree, grandparent, 1);															\
+			prefix##_rotate(tree, grandparent, 1 - side);													\
+		}																									\
+	}																										\
+	prefix##_setRed(tree, tree->root, 0);																	\
+}																											\
+																											\
+static inline int prefix##_insert(prefix* tree, KeyT key, ValT value) {									\
+	if (NULL == tree) {																						\
+		return 1;																							\
+	}																										\
+	/* A full array at the index limit cannot grow, and _reserve reports no growth as success */			\
+	if (RBTREE_INDEX_MAX <= tree->count) {																	\
+		return 1;																							\
+	}																										\
+	if (tree->count == tree->capacity																		\
+		&& 0 != prefix##_reserve(tree, (RBTREE_INDEX_MAX / 2 < tree->capacity) ? RBTREE_INDEX_MAX : 2 * tree->capacity)) {	\
+		return 1;																							\
+	}																										\
+	prefix##Node* nodes = tree->nodes;																		\
+	uint32_t currTreeParent = RBTREE_NIL;																	\
+	uint32_t currTreeNode = tree->root;																		\
+	int dir = 0;																							\
+	/* Equal keys go right, as in RBTree_insert */															\
+	while (RBTREE_NIL != currTreeNode) {																	\
+		currTreeParent = currTreeNode;																		\
+		dir = (0 <= CMP_EXPR(nodes[currTreeNode].key, key));												\
+		currTreeNode = nodes[currTreeNode].children[dir];													\
+	}																										\
+	uint32_t newNode = tree->count++;																		\
+	nodes[newNode].parent = (currTreeParent << 1) | 1u;														\
+	nodes[newNode].children[0] = RBTREE_NIL;																\
+	nodes[newNode].children[1] = RBTREE_NIL;																\
+	nodes[newNode].key = key;																				\
+	nodes[newNode].value = value;																			\
+	if (RBTREE_NIL == currTreeParent) {																		\
+		tree->root = newNode;																				\
+	} else {																								\
+		nodes[currTreeParent].children[dir] = newNode;														\
+	}																										\
+	prefix##_repairAfterInsert(tree, newNode);																\
+	return 0;																								\
+}																											\
+																											\
+static inline ValT* prefix##_search(prefix* tree, KeyT key) {												\
+	if (NULL == tree) {																						\
+		return NULL;																						\
+	}																										\
+	prefix##Node* nodes = tree->nodes;																		\
+	uint32_t currNode = tree->root;																			\
+	while (RBTREE_NIL != currNode) {																		\
+		int order = CMP_EXPR(nodes[currNode].key, key);														\
+		if (0 == order) {																					\
+			return &nodes[currNode].value;																	\
+		}																									\
+		currNode = nodes[currNode].children[0 > order ? 0 : 1];												\
+	}																										\
+	return NULL;																							\
+}																											\
+																											\
+static inline void prefix##Iterator_init(prefix##Iterator* iter, prefix* tree) {							\
+	iter->tree = tree;																						\
+	iter->currNode = RBTREE_NIL;																			\
+	iter->nextNode = (NULL == tree) ? RBTREE_NIL : tree->root;												\
+	while (RBTREE_NIL != iter->nextNode && RBTREE_NIL != tree->nodes[iter->nextNode].children[0]) {			\
+		iter->nextNode = tree->nodes[iter->nextNode].children[0];											\
+	}																										\
+}																											\
+																											\
+static inline int prefix##Iterator_hasNext(prefix##Iterator* iter) {										\
+	return (RBTREE_NIL == iter->nextNode) ? 0 : 1;															\
+}																											\
+																											\
+static inline void prefix##Iterator_getNext(prefix##Iterator* iter) {										\
+	prefix##Node* nodes = iter->tree->nodes;																\
+	iter->currNode = iter->nextNode;																		\
+	if (RBTREE_NIL == iter->currNode) {																		\
+		return;																								\
+	}																										\
+	if (RBTREE_NIL != nodes[iter->currNode].children[1]) {													\
+		iter->nextNode = nodes[iter->currNode].children[1];													\
+		while (RBTREE_NIL != nodes[iter->nextNode].children[0]) {											\
+			iter->nextNode = nodes[iter->nextNode].children[0];												\
+		}																									\
+	} else {																								\
+		uint32_t n = iter->currNode;																		\
+		uint32_t p = prefix##_getParent(iter->tree, n);														\
+		while (RBTREE_NIL != p && n == nodes[p].children[1]) {												\
+			n = p;																							\
+			p = prefix##_getParent(iter->tree, p);															\
+		}																									\
+		iter->nextNode = p;																					\
+	}																										\
+}																											\
+																											\
+static inline KeyT prefix##Iterator_getKey(prefix##Iterator* iter) {										\
+	return iter->tree->nodes[iter->currNode].key;															\
+}																											\
+																											\
+static inline ValT* prefix##Iterator_getValue(prefix##Iterator* iter) {									\
+	return &iter->tree->nodes[iter->currNode].value;														\
+}
+
+#endif
@@ -0,0 +1,67 @@
+// Test.h
+// Shared helpers for the RBTree tests. Each test is its own program and exits nonzero on the first failure.
+
+#ifndef TEST_H
+#define TEST_H
+
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "RBTree.h"
+
+#define TEST_CHECK(condition) do { \
+	if (!(condition)) { \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		exit(1); \
+	} \
+} while (0)
+
+// Deterministic generator so failures reproduce, xorshift32
+static inline unsigned int Test_random(unsigned int* state) {
+	*state ^= *state << 13;
+	*state ^= *state >> 17;
+	*state ^= *state << 5;
+	return *state;
+}
+
+static inline int Test_checkRedBlackNode(RBTree* tree, RBNode* node, RBNode* parent, int checkSizes, int* count) {
+	// Returns the black height of node, checking order, colors, links and subtree sizes below it
+	if (NULL == node) {
+		return 1;
+	}
+	Comparator compare = RBTree_getKeyCompareFunction(tree);
+	TEST_CHECK(parent == RBNode_getParent(node));
+	RBNode* left = RBNode_getLeftChild(node);
+	RBNode* right = RBNode_getRightChild(node);
+	if (RED == RBNode_getColor(node)) {
+		TEST_CHECK(RED != RBNode_getColor(left) && RED != RBNode_getColor(right));
+	}
+	TEST_CHECK(NULL == left || 0 <= compare(RBNode_getKey(left), RBNode_getKey(node)));
+	TEST_CHECK(NULL == right || 0 >= compare(RBNode_getKey(right), RBNode_getKey(node)));
+	int before = *count;
+	int leftHeight = Test_checkRedBlackNode(tree, left, node, checkSizes, count);
+	(*count)++;
+	int rightHeight = Test_checkRedBlackNode(tree, right, node, checkSizes, count);
+	TEST_CHECK(leftHeight == rightHeight);
+	if (checkSizes) {
+		TEST_CHECK(*count - before == RBNode_getSize(node));
+	}
+	return leftHeight + (BLACK == RBNode_getColor(node));
+}
+
+// Checks the red-black invariants and RBTree_size, and subtree sizes when checkSizes, returns the node count
+static inline int Test_checkRedBlack(RBTree* tree, int checkSizes) {
+	RBNode* root = RBTree_getRoot(tree);
+	TEST_CHECK(NULL == root || BLACK == RBNode_getColor(root));
+	int count = 0;
+	Test_checkRedBlackNode(tree, root, NULL, checkSizes, &count);
+	TEST_CHECK(count == RBTree_size(tree));
+	return count;
+}
+
+#endif
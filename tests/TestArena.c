@@ -0,0 +1,44 @@
+// TestArena.c
+// Arena trees that split and union in both directions free every slab.
+
+#include "Test.h"
+
+#define TEST_KEYS 4000
+
+int main() {
+	static int keys[TEST_KEYS];
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = i;
+	}
+	RBTree* first = RBTree_createWithArena(intCompare, 64);
+	RBTree* second = RBTree_createWithArena(intCompare, 64);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		RBTree_insert((0 == i % 2) ? first : second, &keys[i], &keys[i]);
+	}
+	// Each half shares an arena with its source, then the halves cross over
+	int middle = TEST_KEYS / 2;
+	RBTree* firstUpper = RBTree_split(first, &keys[middle]);
+	RBTree* secondUpper = RBTree_split(second, &keys[middle]);
+	TEST_CHECK(0 == RBTree_union(first, secondUpper));
+	TEST_CHECK(0 == RBTree_union(second, firstUpper));
+	TEST_CHECK(TEST_KEYS / 2 == RBTree_size(first) && TEST_KEYS / 2 == RBTree_size(second));
+
+	// Both arenas must still hand out and take back nodes after the merge
+	for (int i = 0; i < TEST_KEYS; i += 3) {
+		RBTree_remove(first, &keys[i]);
+		RBTree_insert(second, &keys[i], &keys[i]);
+	}
+	TEST_CHECK(0 == RBTree_union(first, second));
+	int expected = 0;
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, first);
+	while (RBTreeIterator_hasNext(&iter)) {
+		RBTreeIterator_getNext(&iter);
+		expected++;
+	}
+	TEST_CHECK(expected == RBTree_size(first));
+
+	// Unions deleted the other trees, the last one must free both arenas
+	RBTree_delete(first);
+	return 0;
+}
@@ -0,0 +1,87 @@
+// TestBTree.c
+// Random inserts with duplicates into comparator and int B-trees, checked against a count of each key.
+
+#include "Test.h"
+#include <limits.h>
+
+#define TEST_KEYS 20000
+#define TEST_RANGE 5000
+
+int Test_checkNode(BTree* tree, BTreeNode* node, int isRoot) {
+	// Fill bounds, int copies and ordering within the node, returns the height of its subtree
+	TEST_CHECK(isRoot ? 1 <= node->count : BTREE_MIN_DEGREE - 1 <= node->count);
+	TEST_CHECK(BTREE_MAX_KEYS >= node->count);
+	for (int i = 0; i <= BTREE_MAX_KEYS; i++) {
+		int expected = (tree->intKeys && i < node->count) ? *(int*)node->keys[i] : INT_MAX;
+		TEST_CHECK(expected == node->intKeys[i]);
+	}
+	for (int i = 1; i < node->count; i++) {
+		TEST_CHECK(*(int*)node->keys[i - 1] <= *(int*)node->keys[i]);
+	}
+	if (node->leaf) {
+		return 1;
+	}
+	int height = Test_checkNode(tree, node->children[0], 0);
+	for (int i = 1; i <= node->count; i++) {
+		TEST_CHECK(height == Test_checkNode(tree, node->children[i], 0));
+	}
+	return height + 1;
+}
+
+void Test_check(BTree* tree, int* keys, int* counts, int inserted) {
+	// In key order, equal keys in insertion order, every key found and no other
+	TEST_CHECK(inserted == BTree_size(tree));
+	if (0 < inserted) {
+		Test_checkNode(tree, tree->root, 1);
+	}
+	static int seen[TEST_RANGE];
+	memset(seen, 0, sizeof(seen));
+	BTreeIterator iter;
+	BTreeIterator_init(&iter, tree);
+	int* prev = NULL;
+	int visited = 0;
+	while (BTreeIterator_hasNext(&iter)) {
+		BTreeIterator_getNext(&iter);
+		int* key = BTreeIterator_getKey(&iter);
+		int* value = BTreeIterator_getValue(&iter);
+		// Values point at the key they were inserted with, so the entry's position gives its insertion order
+		TEST_CHECK(key == value);
+		TEST_CHECK(NULL == prev || *prev < *key || (*prev == *key && prev < key));
+		seen[*key]++;
+		prev = key;
+		visited++;
+	}
+	TEST_CHECK(inserted == visited);
+	for (int key = 0; key < TEST_RANGE; key++) {
+		TEST_CHECK(counts[key] == seen[key]);
+		int* value = BTree_search(tree, &key);
+		TEST_CHECK((0 < counts[key]) == (NULL != value));
+		TEST_CHECK(NULL == value || (key == *value && value >= keys && value < keys + inserted));
+	}
+	int outside[2] = {-1, TEST_RANGE};
+	TEST_CHECK(NULL == BTree_search(tree, &outside[0]) && NULL == BTree_search(tree, &outside[1]));
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	static int counts[TEST_RANGE];
+	for (int mode = 0; mode < 2; mode++) {
+		BTree* tree = mode ? BTree_createInt() : BTree_create(intCompare);
+		TEST_CHECK(NULL != tree);
+		memset(counts, 0, sizeof(counts));
+		unsigned int seed = 2463534242u;
+		Test_check(tree, keys, counts, 0);
+		for (int i = 0; i < TEST_KEYS; i++) {
+			keys[i] = Test_random(&seed) % TEST_RANGE;
+			TEST_CHECK(0 == BTree_insert(tree, &keys[i], &keys[i]));
+			counts[keys[i]]++;
+			// Every insert through the first root and leaf splits, then now and then
+			if (i < 2000 || 0 == i % 997) {
+				Test_check(tree, keys, counts, i + 1);
+			}
+		}
+		Test_check(tree, keys, counts, TEST_KEYS);
+		BTree_delete(tree);
+	}
+	return 0;
+}
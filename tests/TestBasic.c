@@ -0,0 +1,38 @@
+// TestBasic.c
+// Insert, search, iterate and delete on malloc and arena trees.
+
+#include "Test.h"
+
+#define TEST_KEYS 10000
+
+int main() {
+	static int keys[TEST_KEYS];
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = (i * 7919) % TEST_KEYS;
+	}
+	for (int arena = 0; arena < 2; arena++) {
+		RBTree* tree = arena ? RBTree_createWithArena(intCompare, 0) : RBTree_create(intCompare);
+		TEST_CHECK(NULL != tree);
+		for (int i = 0; i < TEST_KEYS; i++) {
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &keys[i]));
+		}
+		TEST_CHECK(TEST_KEYS == RBTree_size(tree));
+		for (int i = 0; i < TEST_KEYS; i++) {
+			TEST_CHECK(&keys[i] == RBTree_search(tree, &keys[i]));
+		}
+		int missing = TEST_KEYS;
+		TEST_CHECK(NULL == RBTree_search(tree, &missing));
+
+		RBTreeIterator iter;
+		RBTreeIterator_init(&iter, tree);
+		int expected = 0;
+		while (RBTreeIterator_hasNext(&iter)) {
+			RBTreeIterator_getNext(&iter);
+			TEST_CHECK(expected == *(int*)RBTreeIterator_getKey(&iter));
+			expected++;
+		}
+		TEST_CHECK(TEST_KEYS == expected);
+		RBTree_delete(tree);
+	}
+	return 0;
+}
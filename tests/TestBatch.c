@@ -0,0 +1,58 @@
+// TestBatch.c
+// RBTree_insertBatch against repeated RBTree_insert, and its all-or-nothing failure.
+
+#include "Test.h"
+
+#define TEST_KEYS 5000
+
+int main() {
+	static int keys[TEST_KEYS];
+	void* keyPtrs[TEST_KEYS];
+	unsigned int state = 11;
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = (int)(Test_random(&state) % 1000);
+		keyPtrs[i] = &keys[i];
+	}
+	for (int arena = 0; arena < 2; arena++) {
+		RBTree* tree = arena ? RBTree_createWithArena(intCompare, 64) : RBTree_create(intCompare);
+		RBTree* reference = RBTree_create(intCompare);
+		for (int i = 0; i < TEST_KEYS; i += 500) {
+			TEST_CHECK(0 == RBTree_insertBatch(tree, keyPtrs + i, keyPtrs + i, 500));
+		}
+		for (int i = 0; i < TEST_KEYS; i++) {
+			RBTree_insert(reference, &keys[i], &keys[i]);
+		}
+		// Equal keys must come out in the same order as repeated inserts
+		RBTreeIterator iter, referenceIter;
+		RBTreeIterator_init(&iter, tree);
+		RBTreeIterator_init(&referenceIter, reference);
+		while (RBTreeIterator_hasNext(&referenceIter)) {
+			TEST_CHECK(RBTreeIterator_hasNext(&iter));
+			RBTreeIterator_getNext(&iter);
+			RBTreeIterator_getNext(&referenceIter);
+			TEST_CHECK(RBTreeIterator_getValue(&referenceIter) == RBTreeIterator_getValue(&iter));
+		}
+		TEST_CHECK(!RBTreeIterator_hasNext(&iter));
+
+		// A rejected batch leaves the tree as it was
+		keyPtrs[7] = NULL;
+		TEST_CHECK(1 == RBTree_insertBatch(tree, keyPtrs, keyPtrs, 100));
+		keyPtrs[7] = &keys[7];
+		TEST_CHECK(TEST_KEYS == RBTree_size(tree));
+		RBTree_delete(reference);
+		RBTree_delete(tree);
+	}
+
+	// Reserved nodes wait on the free list until inserts take them
+	RBTree* tree = RBTree_create(intCompare);
+	TEST_CHECK(0 == RBTree_reserveNodes(tree, 100));
+	int reserved = 0;
+	for (RBNode* node = tree->freeNodes; NULL != node; node = node->parent) {
+		reserved++;
+	}
+	TEST_CHECK(100 == reserved);
+	TEST_CHECK(0 == RBTree_insertBatch(tree, keyPtrs, keyPtrs, 100));
+	TEST_CHECK(NULL == tree->freeNodes);
+	RBTree_delete(tree);
+	return 0;
+}
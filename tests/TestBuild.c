@@ -0,0 +1,62 @@
+// TestBuild.c
+// RBTree_buildFromSorted yields valid red-black trees at every shape of the last level and rejects unsorted keys.
+
+#include "Test.h"
+
+#define TEST_MAX_KEYS 100000
+
+int main() {
+	static int keys[TEST_MAX_KEYS];
+	static void* keyPtrs[TEST_MAX_KEYS];
+	static void* valuePtrs[TEST_MAX_KEYS];
+	for (int i = 0; i < TEST_MAX_KEYS; i++) {
+		// Pairs of equal keys, which count as sorted
+		keys[i] = i / 2;
+		keyPtrs[i] = &keys[i];
+		valuePtrs[i] = &keys[TEST_MAX_KEYS - 1 - i];
+	}
+	// Empty, tiny, one short of a full tree, a full tree, one past it, and large
+	int sizes[] = {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 1023, 1024, 1025, 65535, 65536, TEST_MAX_KEYS};
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		int n = sizes[s];
+		RBTree* tree = RBTree_buildFromSorted(keyPtrs, valuePtrs, n, intCompare);
+		TEST_CHECK(NULL != tree);
+#ifdef RBTREE_COMPACT_NODES
+		TEST_CHECK(n == Test_checkRedBlack(tree, 0));
+#else
+		TEST_CHECK(n == Test_checkRedBlack(tree, 1));
+#endif
+		TEST_CHECK(n == RBTree_size(tree));
+		RBTreeIterator iter;
+		RBTreeIterator_init(&iter, tree);
+		for (int i = 0; i < n; i++) {
+			TEST_CHECK(RBTreeIterator_hasNext(&iter));
+			RBTreeIterator_getNext(&iter);
+			TEST_CHECK(keyPtrs[i] == RBTreeIterator_getKey(&iter));
+			TEST_CHECK(valuePtrs[i] == RBTreeIterator_getValue(&iter));
+		}
+		TEST_CHECK(!RBTreeIterator_hasNext(&iter));
+		// The built tree takes ordinary inserts and removals afterwards
+		if (0 < n) {
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[n / 2], &keys[n / 2]));
+			TEST_CHECK(0 == RBTree_remove(tree, &keys[0]));
+			TEST_CHECK(n == Test_checkRedBlack(tree, 0));
+		}
+		RBTree_delete(tree);
+	}
+
+	// One key out of place anywhere fails the build
+	int positions[] = {1, 2, 500, 999};
+	for (size_t p = 0; p < sizeof(positions) / sizeof(positions[0]); p++) {
+		int at = positions[p];
+		void* swapped = keyPtrs[at];
+		keyPtrs[at] = keyPtrs[at - 1];
+		keyPtrs[at - 1] = &keys[TEST_MAX_KEYS - 1];
+		TEST_CHECK(NULL == RBTree_buildFromSorted(keyPtrs, valuePtrs, 1000, intCompare));
+		keyPtrs[at - 1] = keyPtrs[at];
+		keyPtrs[at] = swapped;
+	}
+	TEST_CHECK(NULL == RBTree_buildFromSorted(keyPtrs, valuePtrs, -1, intCompare));
+	TEST_CHECK(NULL == RBTree_buildFromSorted(NULL, valuePtrs, 1, intCompare));
+	return 0;
+}
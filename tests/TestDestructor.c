@@ -0,0 +1,95 @@
+// TestDestructor.c
+// Key and value destructors run exactly once for each entry that leaves a tree, and never for moved nodes.
+
+#include "Test.h"
+
+#define TEST_KEYS 1000
+
+static int Test_keyCalls[TEST_KEYS];
+static int Test_valueCalls[TEST_KEYS];
+static int Test_keys[TEST_KEYS];
+static int Test_values[TEST_KEYS];
+
+void Test_destroyKey(void* key) {
+	Test_keyCalls[(int*)key - Test_keys]++;
+}
+
+void Test_destroyValue(void* value) {
+	Test_valueCalls[(int*)value - Test_values]++;
+}
+
+void Test_checkCalls(int lo, int hi, int expected) {
+	// Entries lo to hi - 1 were each destroyed expected times, key and value alike
+	for (int i = lo; i < hi; i++) {
+		TEST_CHECK(expected == Test_keyCalls[i] && expected == Test_valueCalls[i]);
+	}
+}
+
+RBTree* Test_create(int arena, int lo, int hi) {
+	RBTree* tree = arena ? RBTree_createWithArena(intCompare, 64) : RBTree_create(intCompare);
+	TEST_CHECK(NULL != tree);
+	RBTree_setDestructors(tree, Test_destroyKey, Test_destroyValue);
+	for (int i = lo; i < hi; i++) {
+		TEST_CHECK(0 == RBTree_insert(tree, &Test_keys[i], &Test_values[i]));
+	}
+	return tree;
+}
+
+int main() {
+	for (int i = 0; i < TEST_KEYS; i++) {
+		Test_keys[i] = i;
+	}
+	for (int arena = 0; arena < 2; arena++) {
+		memset(Test_keyCalls, 0, sizeof(Test_keyCalls));
+		memset(Test_valueCalls, 0, sizeof(Test_valueCalls));
+		// The upper half moves into the lower one without being destroyed
+		RBTree* tree = Test_create(arena, 0, TEST_KEYS / 2);
+		RBTree* other = Test_create(arena, TEST_KEYS / 2, TEST_KEYS);
+		TEST_CHECK(0 == RBTree_union(tree, other));
+		Test_checkCalls(0, TEST_KEYS, 0);
+
+		// Remove destroys its entry, a failed remove nothing
+		TEST_CHECK(0 == RBTree_remove(tree, &Test_keys[0]));
+		TEST_CHECK(1 == RBTree_remove(tree, &Test_keys[0]));
+		Test_checkCalls(0, 1, 1);
+		Test_checkCalls(1, TEST_KEYS, 0);
+
+		// Popped entries go to the caller
+		void* key;
+		void* value;
+		TEST_CHECK(0 == RBTree_popMin(tree, &key, &value) && &Test_keys[1] == key && &Test_values[1] == value);
+		TEST_CHECK(0 == RBTree_popMax(tree, &key, &value) && &Test_keys[TEST_KEYS - 1] == key);
+		Test_checkCalls(1, 2, 0);
+		Test_checkCalls(TEST_KEYS - 1, TEST_KEYS, 0);
+
+		// An upsert into a present key keeps the caller's key and the combined value
+		TEST_CHECK(2 == RBTree_upsert(tree, &Test_keys[2], &Test_values[2], NULL));
+		Test_checkCalls(2, 3, 0);
+
+		// Filters destroy what they drop, and leave the filter tree alone
+		RBTree* filter = Test_create(!arena, 0, 0);
+		for (int i = 0; i < TEST_KEYS; i += 2) {
+			TEST_CHECK(0 == RBTree_insert(filter, &Test_keys[i], &Test_keys[i]));
+		}
+		RBTree_setDestructors(filter, NULL, NULL);
+		TEST_CHECK(0 == RBTree_difference(tree, filter));
+		for (int i = 2; i < TEST_KEYS - 1; i++) {
+			Test_checkCalls(i, i + 1, 1 - i % 2);
+		}
+		TEST_CHECK(0 == RBTree_intersect(tree, filter));
+		RBTree_delete(filter);
+		Test_checkCalls(2, TEST_KEYS - 1, 1);
+		TEST_CHECK(0 == RBTree_size(tree));
+
+		// Delete destroys every entry still in the tree
+		for (int i = 2; i < TEST_KEYS - 1; i += 2) {
+			TEST_CHECK(0 == RBTree_insert(tree, &Test_keys[i], &Test_values[i]));
+		}
+		RBTree_delete(tree);
+		for (int i = 2; i < TEST_KEYS - 1; i++) {
+			Test_checkCalls(i, i + 1, 2 - i % 2);
+		}
+		Test_checkCalls(1, 2, 0);
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+// TestForEach.c
+// RBTree_forEach and RBTree_forEachReverse visit every entry in order and stop at the first nonzero result.
+
+#include "Test.h"
+
+#define TEST_KEYS 3000
+
+typedef struct Test_Visit {
+	void** keys;							// Keys seen so far, in visit order
+	int count;								// Number of visits
+	int stopAt;								// Visit that returns nonzero, -1 never
+} TestVisit;
+
+int Test_record(void* key, void* value, void* context) {
+	TestVisit* visit = context;
+	TEST_CHECK(key == value);
+	visit->keys[visit->count] = key;
+	return (visit->count++ == visit->stopAt) ? 7 : 0;
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	static void* seen[TEST_KEYS];
+	TestVisit visit = { seen, 0, -1 };
+	RBTree* tree = RBTree_create(intCompare);
+	// An empty tree has nothing to visit, and no visitor is no walk
+	TEST_CHECK(0 == RBTree_forEach(tree, Test_record, &visit) && 0 == visit.count);
+	TEST_CHECK(0 == RBTree_forEachReverse(tree, Test_record, &visit) && 0 == visit.count);
+	TEST_CHECK(0 == RBTree_forEach(tree, NULL, &visit));
+	// Pairs of equal keys, inserted out of order
+	for (int i = 0; i < TEST_KEYS; i++) {
+		int at = (int)(((long)i * 7919) % TEST_KEYS);
+		keys[at] = at / 2;
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[at], &keys[at]));
+	}
+	// The full walks match the iterator, forwards and backwards
+	TEST_CHECK(0 == RBTree_forEach(tree, Test_record, &visit));
+	TEST_CHECK(TEST_KEYS == visit.count);
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		RBTreeIterator_getNext(&iter);
+		TEST_CHECK(seen[i] == RBTreeIterator_getKey(&iter));
+		TEST_CHECK(i / 2 == *(int*)seen[i]);
+	}
+	static void* forward[TEST_KEYS];
+	memcpy(forward, seen, sizeof(forward));
+	visit.count = 0;
+	TEST_CHECK(0 == RBTree_forEachReverse(tree, Test_record, &visit));
+	TEST_CHECK(TEST_KEYS == visit.count);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		TEST_CHECK(forward[TEST_KEYS - 1 - i] == seen[i]);
+	}
+	// A nonzero result ends the walk right there and is passed back
+	int stops[] = {0, 1, TEST_KEYS / 2, TEST_KEYS - 1};
+	for (size_t s = 0; s < sizeof(stops) / sizeof(stops[0]); s++) {
+		for (int reverse = 0; reverse < 2; reverse++) {
+			visit.count = 0;
+			visit.stopAt = stops[s];
+			TEST_CHECK(7 == (reverse ? RBTree_forEachReverse(tree, Test_record, &visit) : RBTree_forEach(tree, Test_record, &visit)));
+			TEST_CHECK(stops[s] + 1 == visit.count);
+			TEST_CHECK((reverse ? forward[TEST_KEYS - 1 - stops[s]] : forward[stops[s]]) == seen[stops[s]]);
+		}
+	}
+	RBTree_delete(tree);
+	return 0;
+}
@@ -0,0 +1,71 @@
+// TestFrozen.c
+// Frozen bounds and lookups match the source tree, for the Eytzinger layout and the int blocks.
+
+#include "Test.h"
+#include <limits.h>
+
+#define TEST_RANGE 6000
+#define TEST_SIZES 11
+
+void Test_compare(RBTree* tree, RBFrozenTree* frozen, int* probe) {
+	// A bound index names the same shared key as the tree's bound node, size when there is none
+	RBNode* lower = RBTree_lowerBound(tree, probe);
+	RBNode* upper = RBTree_upperBound(tree, probe);
+	int lowerIndex = RBFrozenTree_lowerBound(frozen, probe);
+	int upperIndex = RBFrozenTree_upperBound(frozen, probe);
+	TEST_CHECK((NULL == lower) == (RBFrozenTree_getSize(frozen) == lowerIndex));
+	TEST_CHECK((NULL == upper) == (RBFrozenTree_getSize(frozen) == upperIndex));
+	TEST_CHECK(NULL == lower || RBNode_getKey(lower) == RBFrozenTree_getKey(frozen, lowerIndex));
+	TEST_CHECK(NULL == upper || RBNode_getKey(upper) == RBFrozenTree_getKey(frozen, upperIndex));
+	TEST_CHECK(RBTree_search(tree, probe) == RBFrozenTree_search(frozen, probe));
+}
+
+int main() {
+	static int keys[TEST_RANGE + 2];
+	static int values[TEST_RANGE + 2];
+	// Around the 16-key block and the 17-ary and binary level boundaries
+	int sizes[TEST_SIZES] = {0, 1, 2, 7, 15, 16, 17, 289, 290, 1023, TEST_RANGE};
+	unsigned int seed = 12345;
+	for (int s = 0; s < TEST_SIZES; s++) {
+		RBTree* tree = RBTree_create(intCompare);
+		// Distinct even keys drawn from the range, so every odd probe falls between keys
+		for (int i = 0; i < TEST_RANGE; i++) {
+			keys[i] = 2 * i;
+			values[i] = i;
+		}
+		for (int i = TEST_RANGE - 1; 0 < i; i--) {
+			int j = Test_random(&seed) % (i + 1);
+			int key = keys[i];
+			keys[i] = keys[j];
+			keys[j] = key;
+		}
+		for (int i = 0; i < sizes[s]; i++) {
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &values[i]));
+		}
+		if (TEST_RANGE == sizes[s]) {
+			// The extremes, next to the INT_MAX that pads the last block
+			keys[TEST_RANGE] = INT_MIN;
+			keys[TEST_RANGE + 1] = INT_MAX;
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[TEST_RANGE], &values[TEST_RANGE]));
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[TEST_RANGE + 1], &values[TEST_RANGE + 1]));
+		}
+		RBFrozenTree* frozen = RBTree_freeze(tree);
+		RBFrozenTree* frozenInt = RBTree_freezeInt(tree);
+		TEST_CHECK(NULL != frozen && NULL != frozenInt);
+		TEST_CHECK(RBTree_size(tree) == RBFrozenTree_getSize(frozen));
+		TEST_CHECK(RBTree_size(tree) == RBFrozenTree_getSize(frozenInt));
+		int edges[4] = {INT_MIN, INT_MAX, INT_MIN + 1, INT_MAX - 1};
+		for (int i = 0; i < 4; i++) {
+			Test_compare(tree, frozen, &edges[i]);
+			Test_compare(tree, frozenInt, &edges[i]);
+		}
+		for (int probe = -2; probe <= 2 * TEST_RANGE + 1; probe++) {
+			Test_compare(tree, frozen, &probe);
+			Test_compare(tree, frozenInt, &probe);
+		}
+		RBFrozenTree_delete(frozenInt);
+		RBFrozenTree_delete(frozen);
+		RBTree_delete(tree);
+	}
+	return 0;
+}
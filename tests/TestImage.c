@@ -0,0 +1,184 @@
+// TestImage.c
+// Saved trees load back and search in place, and damaged files fail cleanly instead of being read past their end.
+
+#include "Test.h"
+#include <stdint.h>
+#include <unistd.h>
+
+#define TEST_KEYS 60
+
+size_t Test_serializeInt(void* item, void* buffer, size_t capacity) {
+	if (sizeof(int) <= capacity) {
+		memcpy(buffer, item, sizeof(int));
+	}
+	return sizeof(int);
+}
+
+size_t Test_serializeShort(void* item, void* buffer, size_t capacity) {
+	// Writes keys two bytes wide, the wrong size for Test_deserializeInt
+	short narrow = (short)*(int*)item;
+	if (sizeof(short) <= capacity) {
+		memcpy(buffer, &narrow, sizeof(short));
+	}
+	return sizeof(short);
+}
+
+size_t Test_serializeLong(void* item, void* buffer, size_t capacity) {
+	// Values fill whole eight-byte fields, so a file ends exactly at its last value
+	int64_t wide = -(int64_t)*(int*)item * 1000000007;
+	if (sizeof(wide) <= capacity) {
+		memcpy(buffer, &wide, sizeof(wide));
+	}
+	return sizeof(wide);
+}
+
+void* Test_deserializeInt(void* bytes, size_t length) {
+	if (sizeof(int) != length) {
+		return NULL;
+	}
+	int* item = malloc(sizeof(int));
+	if (NULL != item) {
+		memcpy(item, bytes, sizeof(int));
+	}
+	return item;
+}
+
+void* Test_deserializeLong(void* bytes, size_t length) {
+	if (sizeof(int64_t) != length) {
+		return NULL;
+	}
+	int64_t* item = malloc(sizeof(int64_t));
+	if (NULL != item) {
+		memcpy(item, bytes, sizeof(int64_t));
+	}
+	return item;
+}
+
+static int Test_failAt = -1;
+
+void* Test_deserializeFailing(void* bytes, size_t length) {
+	// Fails on one chosen call, to leave a load half built
+	if (0 == Test_failAt--) {
+		return NULL;
+	}
+	return Test_deserializeLong(bytes, length);
+}
+
+void Test_writeFile(const char* path, unsigned char* bytes, size_t length) {
+	FILE* file = fopen(path, "wb");
+	TEST_CHECK(NULL != file);
+	TEST_CHECK(length == fwrite(bytes, 1, length, file));
+	TEST_CHECK(0 == fclose(file));
+}
+
+RBTree* Test_load(const char* path, Deserializer valueDeserializer) {
+	return RBTree_load(path, intCompare, Test_deserializeInt, valueDeserializer, free, free);
+}
+
+void Test_checkLoaded(RBTree* tree, int* keys, int n) {
+	TEST_CHECK(NULL != tree && n == Test_checkRedBlack(tree, 0));
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	for (int i = 0; i < n; i++) {
+		RBTreeIterator_getNext(&iter);
+		TEST_CHECK(keys[i] == *(int*)RBTreeIterator_getKey(&iter));
+		TEST_CHECK(-(int64_t)keys[i] * 1000000007 == *(int64_t*)RBTreeIterator_getValue(&iter));
+	}
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	char path[] = "/tmp/TestImageXXXXXX";
+	int fd = mkstemp(path);
+	TEST_CHECK(0 <= fd);
+	close(fd);
+
+	// An empty tree round-trips to an empty tree
+	RBTree* tree = RBTree_create(intCompare);
+	TEST_CHECK(0 == RBTree_save(tree, path, Test_serializeInt, Test_serializeLong));
+	RBTree* loaded = Test_load(path, Test_deserializeLong);
+	Test_checkLoaded(loaded, keys, 0);
+	RBTree_delete(loaded);
+
+	// Odd keys, so every even probe is absent
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = 2 * i + 1;
+	}
+	for (int i = 0; i < TEST_KEYS; i++) {
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[(i * 37) % TEST_KEYS], &keys[(i * 37) % TEST_KEYS]));
+	}
+	TEST_CHECK(0 == RBTree_save(tree, path, Test_serializeInt, Test_serializeLong));
+	loaded = Test_load(path, Test_deserializeLong);
+	Test_checkLoaded(loaded, keys, TEST_KEYS);
+	RBTree_delete(loaded);
+	RBTreeImage* image = RBTreeImage_open(path, intCompare);
+	TEST_CHECK(NULL != image && TEST_KEYS == RBTreeImage_getCount(image));
+	for (int probe = -1; probe <= 2 * TEST_KEYS + 1; probe++) {
+		int64_t* value = RBTreeImage_search(image, &probe);
+		TEST_CHECK((1 == probe % 2 && 2 * TEST_KEYS > probe) == (NULL != value));
+		TEST_CHECK(NULL == value || -(int64_t)probe * 1000000007 == *value);
+		// Keys below an odd or even probe p number p / 2
+		int below = (0 > probe) ? 0 : (TEST_KEYS < probe / 2) ? TEST_KEYS : probe / 2;
+		TEST_CHECK(below == RBTreeImage_lowerBound(image, &probe));
+	}
+	TEST_CHECK(NULL == RBTreeImage_getKey(image, TEST_KEYS, NULL) && NULL == RBTreeImage_getValue(image, -1, NULL));
+	RBTreeImage_close(image);
+
+	// Keep the good bytes to damage copies of them
+	FILE* file = fopen(path, "rb");
+	TEST_CHECK(NULL != file);
+	static unsigned char bytes[1 << 16];
+	size_t length = fread(bytes, 1, sizeof(bytes), file);
+	fclose(file);
+	TEST_CHECK(0 < length && sizeof(bytes) > length);
+
+	// Every truncation loses part of some record or of the header, and must fail
+	for (size_t cut = 0; cut < length; cut++) {
+		Test_writeFile(path, bytes, cut);
+		TEST_CHECK(NULL == Test_load(path, Test_deserializeLong));
+	}
+
+	// A bad magic number, an entry count larger than the file, and offsets out of bounds or misaligned
+	bytes[0] ^= 1;
+	Test_writeFile(path, bytes, length);
+	TEST_CHECK(NULL == RBTreeImage_open(path, intCompare));
+	bytes[0] ^= 1;
+	uint64_t count;
+	memcpy(&count, bytes + 8, sizeof(count));
+	uint64_t damaged[] = { count + 1, (uint64_t)1 << 40, UINT64_MAX };
+	for (int i = 0; i < 3; i++) {
+		memcpy(bytes + 8, &damaged[i], sizeof(uint64_t));
+		Test_writeFile(path, bytes, length);
+		// One entry too many still fits the file, but its offset is record bytes that point nowhere
+		image = RBTreeImage_open(path, intCompare);
+		TEST_CHECK((NULL != image) == (count + 1 == damaged[i]));
+		RBTreeImage_close(image);
+		TEST_CHECK(NULL == Test_load(path, Test_deserializeLong));
+	}
+	memcpy(bytes + 8, &count, sizeof(count));
+	uint64_t offset;
+	memcpy(&offset, bytes + 16 + 8 * (TEST_KEYS / 2), sizeof(offset));
+	uint64_t badOffsets[] = { offset + 4, length, length - 8, UINT64_MAX - 7, 0 };
+	for (int i = 0; i < 5; i++) {
+		memcpy(bytes + 16 + 8 * (TEST_KEYS / 2), &badOffsets[i], sizeof(uint64_t));
+		Test_writeFile(path, bytes, length);
+		TEST_CHECK(NULL == Test_load(path, Test_deserializeLong));
+		image = RBTreeImage_open(path, intCompare);
+		TEST_CHECK(NULL != image && NULL == RBTreeImage_getValue(image, TEST_KEYS / 2, NULL));
+		RBTreeImage_close(image);
+	}
+	memcpy(bytes + 16 + 8 * (TEST_KEYS / 2), &offset, sizeof(offset));
+
+	// Keys of the wrong size, and a deserializer failing halfway, free what was built and return NULL
+	TEST_CHECK(0 == RBTree_save(tree, path, Test_serializeShort, Test_serializeLong));
+	TEST_CHECK(NULL == Test_load(path, Test_deserializeLong));
+	TEST_CHECK(0 == RBTree_save(tree, path, Test_serializeInt, Test_serializeLong));
+	Test_failAt = TEST_KEYS / 2;
+	TEST_CHECK(NULL == Test_load(path, Test_deserializeFailing));
+	TEST_CHECK(NULL == Test_load("/nonexistent/TestImage", Test_deserializeLong));
+	TEST_CHECK(1 == RBTree_save(tree, "/nonexistent/TestImage", Test_serializeInt, Test_serializeLong));
+
+	RBTree_delete(tree);
+	unlink(path);
+	return 0;
+}
@@ -0,0 +1,46 @@
+// TestIndexed.c
+// The index-linked template tree: inserts, lookups, ordered iteration and the index limit.
+
+#include "Test.h"
+#include "RBTreeTemplate.h"
+
+#define TEST_KEYS 20000
+
+RBTREE_DEFINE_INDEXED(TestIndexedTree, int, int, RBTREE_CMP_NUMERIC)
+
+int main() {
+	TestIndexedTree* tree = TestIndexedTree_create();
+	TEST_CHECK(NULL != tree);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		int key = (i * 7919) % TEST_KEYS;
+		TEST_CHECK(0 == TestIndexedTree_insert(tree, key, -key));
+	}
+	for (int key = 0; key < TEST_KEYS; key++) {
+		int* value = TestIndexedTree_search(tree, key);
+		TEST_CHECK(NULL != value && -key == *value);
+	}
+	TEST_CHECK(NULL == TestIndexedTree_search(tree, TEST_KEYS));
+	TestIndexedTreeIterator iter;
+	TestIndexedTreeIterator_init(&iter, tree);
+	int expected = 0;
+	while (TestIndexedTreeIterator_hasNext(&iter)) {
+		TestIndexedTreeIterator_getNext(&iter);
+		TEST_CHECK(expected++ == TestIndexedTreeIterator_getKey(&iter));
+	}
+	TEST_CHECK(TEST_KEYS == expected);
+	TestIndexedTree_delete(tree);
+
+	// Pretend the array already holds the most slots an index can name: the insert must fail, not write past it
+	tree = TestIndexedTree_create();
+	uint32_t count = tree->count;
+	uint32_t capacity = tree->capacity;
+	tree->count = RBTREE_INDEX_MAX;
+	tree->capacity = RBTREE_INDEX_MAX;
+	TEST_CHECK(1 == TestIndexedTree_insert(tree, 1, 1));
+	TEST_CHECK(RBTREE_NIL == tree->root);
+	tree->count = count;
+	tree->capacity = capacity;
+	TEST_CHECK(0 == TestIndexedTree_insert(tree, 1, 1));
+	TestIndexedTree_delete(tree);
+	return 0;
+}
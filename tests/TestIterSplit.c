@@ -0,0 +1,61 @@
+// TestIterSplit.c
+// RBTreeIterator_split parts cover every key exactly once and in order, for every part count.
+
+#include "Test.h"
+
+#define TEST_KEYS 300
+
+void Test_checkParts(RBTree* tree, RBTreeIterator* iters, void** order, int n, int count) {
+	// Walking the parts one after another must give the full in-order sequence
+	TEST_CHECK(0 == RBTreeIterator_split(tree, iters, count));
+	int at = 0;
+	for (int i = 0; i < count; i++) {
+		int start = at;
+		while (RBTreeIterator_hasNext(&iters[i])) {
+			RBTreeIterator_getNext(&iters[i]);
+			TEST_CHECK(at < n && order[at] == RBTreeIterator_getKey(&iters[i]));
+			at++;
+		}
+		if (RBTree_isAugmented(tree)) {
+			// Subtree sizes give parts that differ by at most one key
+			TEST_CHECK(n / count == at - start || n / count + 1 == at - start);
+		}
+	}
+	TEST_CHECK(n == at);
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	static void* order[TEST_KEYS];
+	static RBTreeIterator iters[TEST_KEYS + 2];
+#ifdef RBTREE_COMPACT_NODES
+	int modes = 1;
+#else
+	int modes = 2;
+#endif
+	for (int augmented = 0; augmented < modes; augmented++) {
+		RBTree* tree = RBTree_create(intCompare);
+		TEST_CHECK(0 == RBTree_setAugmented(tree, augmented));
+		// An empty tree splits into empty parts
+		Test_checkParts(tree, iters, order, 0, 3);
+		for (int i = 0; i < TEST_KEYS; i++) {
+			int at = (int)(((long)i * 7919) % TEST_KEYS);
+			keys[at] = at / 3;
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[at], &keys[at]));
+		}
+		RBTreeIterator iter;
+		RBTreeIterator_init(&iter, tree);
+		for (int i = 0; i < TEST_KEYS; i++) {
+			RBTreeIterator_getNext(&iter);
+			order[i] = RBTreeIterator_getKey(&iter);
+		}
+		// More parts than keys leaves some of them empty
+		for (int count = 1; count <= TEST_KEYS + 2; count++) {
+			Test_checkParts(tree, iters, order, TEST_KEYS, count);
+		}
+		TEST_CHECK(1 == RBTreeIterator_split(tree, iters, 0));
+		TEST_CHECK(1 == RBTreeIterator_split(NULL, iters, 1));
+		RBTree_delete(tree);
+	}
+	return 0;
+}
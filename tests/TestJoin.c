@@ -0,0 +1,154 @@
+// TestJoin.c
+// Join, and parallel union, intersect and difference, against per-key counts, for malloc and arena trees.
+
+#include "Test.h"
+
+#define TEST_RANGE 1000
+#define TEST_KEYS 3000
+
+RBTree* Test_create(int arena, int augmented) {
+	RBTree* tree = arena ? RBTree_createWithArena(intCompare, 256) : RBTree_create(intCompare);
+	TEST_CHECK(NULL != tree);
+	TEST_CHECK(0 == RBTree_setAugmented(tree, augmented));
+	return tree;
+}
+
+void Test_fill(RBTree* tree, int* slots, int* counts, int n, unsigned int* state) {
+	// Random keys with duplicates, counted per key
+	for (int i = 0; i < n; i++) {
+		int key = (int)(Test_random(state) % TEST_RANGE);
+		TEST_CHECK(0 == RBTree_insert(tree, &slots[key], &slots[key]));
+		counts[key]++;
+	}
+}
+
+void Test_checkCounts(RBTree* tree, int* counts) {
+	// The tree holds exactly counts[k] copies of each key k, in order
+	int n = 0;
+	for (int key = 0; key < TEST_RANGE; key++) {
+		n += counts[key];
+	}
+	TEST_CHECK(n == Test_checkRedBlack(tree, RBTree_isAugmented(tree)));
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	for (int key = 0; key < TEST_RANGE; key++) {
+		for (int i = 0; i < counts[key]; i++) {
+			TEST_CHECK(RBTreeIterator_hasNext(&iter));
+			RBTreeIterator_getNext(&iter);
+			TEST_CHECK(key == *(int*)RBTreeIterator_getKey(&iter));
+		}
+	}
+	TEST_CHECK(!RBTreeIterator_hasNext(&iter));
+}
+
+void Test_join(int* slots, int arena, int augmented, unsigned int* state) {
+	static int leftCounts[TEST_RANGE];
+	static int rightCounts[TEST_RANGE];
+	memset(leftCounts, 0, sizeof(leftCounts));
+	memset(rightCounts, 0, sizeof(rightCounts));
+	// Left holds keys up to middle, right keys from middle on, of different black heights
+	int middle = 1 + (int)(Test_random(state) % (TEST_RANGE - 2));
+	int leftCount = (int)(Test_random(state) % 600);
+	int rightCount = (int)(Test_random(state) % 600);
+	RBTree* left = Test_create(arena, augmented);
+	RBTree* right = Test_create(arena, augmented);
+	for (int i = 0; i < leftCount; i++) {
+		int key = (int)(Test_random(state) % (middle + 1));
+		TEST_CHECK(0 == RBTree_insert(left, &slots[key], &slots[key]));
+		leftCounts[key]++;
+	}
+	for (int i = 0; i < rightCount; i++) {
+		int key = middle + (int)(Test_random(state) % (TEST_RANGE - middle));
+		TEST_CHECK(0 == RBTree_insert(right, &slots[key], &slots[key]));
+		rightCounts[key]++;
+	}
+	// A middle key outside the gap is rejected and both trees are left as they were
+	int below = -1;
+	int above = TEST_RANGE;
+	if (0 < leftCount) {
+		TEST_CHECK(1 == RBTree_join(left, &below, &below, right));
+	}
+	if (0 < rightCount) {
+		TEST_CHECK(1 == RBTree_join(left, &above, &above, right));
+	}
+	Test_checkCounts(left, leftCounts);
+	Test_checkCounts(right, rightCounts);
+	TEST_CHECK(0 == RBTree_join(left, &slots[middle], &slots[middle], right));
+	for (int key = 0; key < TEST_RANGE; key++) {
+		leftCounts[key] += rightCounts[key];
+	}
+	leftCounts[middle]++;
+	Test_checkCounts(left, leftCounts);
+	RBTree_delete(left);
+}
+
+void Test_combine(int* slots, int arena, int augmented, int threads, unsigned int* state) {
+	static int counts[TEST_RANGE];
+	static int otherCounts[TEST_RANGE];
+	memset(counts, 0, sizeof(counts));
+	memset(otherCounts, 0, sizeof(otherCounts));
+	RBTree* tree = Test_create(arena, augmented);
+	RBTree* other = Test_create(arena, augmented);
+	RBTree* filter = Test_create(!arena, 0);
+	Test_fill(tree, slots, counts, TEST_KEYS, state);
+	Test_fill(other, slots, otherCounts, TEST_KEYS / 2, state);
+	// Union moves other's nodes, and arena, into tree
+	TEST_CHECK(0 == Par_RBTree_union(tree, other, threads));
+	for (int key = 0; key < TEST_RANGE; key++) {
+		counts[key] += otherCounts[key];
+	}
+	Test_checkCounts(tree, counts);
+	// The filter keeps about a third of the keys
+	static int filterCounts[TEST_RANGE];
+	memset(filterCounts, 0, sizeof(filterCounts));
+	for (int key = 0; key < TEST_RANGE; key += 3) {
+		TEST_CHECK(0 == RBTree_insert(filter, &slots[key], &slots[key]));
+		filterCounts[key]++;
+	}
+	TEST_CHECK(0 == Par_RBTree_difference(tree, filter, threads));
+	for (int key = 0; key < TEST_RANGE; key += 3) {
+		counts[key] = 0;
+	}
+	Test_checkCounts(tree, counts);
+	TEST_CHECK(0 == Par_RBTree_intersect(filter, tree, threads));
+	Test_checkCounts(filter, (int[TEST_RANGE]){0});
+	// Nodes of the merged arena can still be freed and reused
+	for (int key = 0; key < TEST_RANGE; key += 2) {
+		while (0 < counts[key]) {
+			TEST_CHECK(0 == RBTree_remove(tree, &slots[key]));
+			counts[key]--;
+		}
+	}
+	Test_fill(tree, slots, counts, TEST_KEYS / 4, state);
+	Test_checkCounts(tree, counts);
+	RBTree_delete(filter);
+	RBTree_delete(tree);
+}
+
+int main() {
+	static int slots[TEST_RANGE];
+	for (int i = 0; i < TEST_RANGE; i++) {
+		slots[i] = i;
+	}
+	unsigned int state = 17;
+#ifdef RBTREE_COMPACT_NODES
+	int modes = 2;
+#else
+	int modes = 4;
+#endif
+	for (int mode = 0; mode < modes; mode++) {
+		for (int round = 0; round < 20; round++) {
+			Test_join(slots, mode & 1, mode >> 1, &state);
+		}
+		for (int threads = 1; threads <= 8; threads *= 2) {
+			Test_combine(slots, mode & 1, mode >> 1, threads, &state);
+		}
+	}
+	// Join refuses trees that allocate differently
+	RBTree* arenaTree = Test_create(1, 0);
+	RBTree* mallocTree = Test_create(0, 0);
+	TEST_CHECK(1 == RBTree_join(arenaTree, &slots[0], &slots[0], mallocTree));
+	RBTree_delete(mallocTree);
+	RBTree_delete(arenaTree);
+	return 0;
+}
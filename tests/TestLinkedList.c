@@ -0,0 +1,125 @@
+// TestLinkedList.c
+// The unrolled list: node splits, merges and unlinking on remove, the tail pointer and indexing across nodes.
+
+#include "Test.h"
+
+#define TEST_STEPS 100000
+#define TEST_MAX_SIZE 2000
+
+void Test_check(LinkedList* list, long* model, int size) {
+	// Node fill, the tail as the last node, and every value by index and by iteration
+	TEST_CHECK(size == LinkedList_size(list));
+	int counted = 0;
+	ListNode* last = NULL;
+	for (ListNode* currNode = list->head; NULL != currNode; currNode = currNode->next) {
+		TEST_CHECK(0 < currNode->count && LISTNODE_CAPACITY >= currNode->count);
+		counted += currNode->count;
+		last = currNode;
+	}
+	TEST_CHECK(size == counted);
+	TEST_CHECK(last == list->tail);
+	for (int i = 0; i < size; i++) {
+		TEST_CHECK(model[i] == (long)LinkedList_get(list, i));
+	}
+	TEST_CHECK(NULL == LinkedList_get(list, size));
+	LinkedListIterator iter;
+	LinkedListIterator_init(&iter, list);
+	int visited = 0;
+	while (LinkedListIterator_hasNext(&iter)) {
+		LinkedListIterator_getNext(&iter);
+		TEST_CHECK(visited < size && model[visited] == (long)LinkedListIterator_getValue(&iter));
+		visited++;
+	}
+	TEST_CHECK(size == visited);
+}
+
+void Test_add(LinkedList* list, long* model, int* size, int index, long value) {
+	TEST_CHECK(0 == LinkedList_add(list, index, (void*)value));
+	memmove(model + index + 1, model + index, (size_t)(*size - index) * sizeof(long));
+	model[index] = value;
+	(*size)++;
+}
+
+void Test_remove(LinkedList* list, long* model, int* size, int index) {
+	TEST_CHECK(model[index] == (long)LinkedList_remove(list, index));
+	memmove(model + index, model + index + 1, (size_t)(*size - index - 1) * sizeof(long));
+	(*size)--;
+}
+
+int main() {
+	static long model[TEST_MAX_SIZE];
+	int size = 0;
+	LinkedList* list = LinkedList_create();
+	TEST_CHECK(NULL == LinkedList_remove(list, 0) && NULL == LinkedList_get(list, 0));
+	TEST_CHECK(1 == LinkedList_add(list, 1, (void*)1) && 1 == LinkedList_add(list, -1, (void*)1));
+
+	// Inserting into the middle of a full tail node splits it, and the new half becomes the tail
+	for (int i = 0; i < LISTNODE_CAPACITY; i++) {
+		Test_add(list, model, &size, size, i + 1);
+	}
+	TEST_CHECK(list->head == list->tail);
+	Test_add(list, model, &size, 5, 100);
+	TEST_CHECK(list->head != list->tail && list->head->next == list->tail);
+	TEST_CHECK(LISTNODE_CAPACITY / 2 + 1 == list->head->count && LISTNODE_CAPACITY / 2 == list->tail->count);
+	Test_check(list, model, size);
+
+	// Removing below half full folds the next node back in, which was the tail
+	Test_remove(list, model, &size, 0);
+	TEST_CHECK(list->head != list->tail);
+	Test_remove(list, model, &size, 0);
+	TEST_CHECK(list->head == list->tail);
+	Test_check(list, model, size);
+
+	// Emptying the tail node unlinks it and moves the tail back
+	while (size < 2 * LISTNODE_CAPACITY + 1) {
+		Test_add(list, model, &size, size, 200 + size);
+	}
+	TEST_CHECK(1 == list->tail->count);
+	ListNode* middle = list->head->next;
+	Test_remove(list, model, &size, size - 1);
+	TEST_CHECK(middle == list->tail && NULL == middle->next);
+	Test_check(list, model, size);
+	Test_add(list, model, &size, size, 300);
+	Test_check(list, model, size);
+
+	// Emptying a middle node, too full to merge with its neighbour, relinks around it
+	while (size < 3 * LISTNODE_CAPACITY) {
+		Test_add(list, model, &size, size, 400 + size);
+	}
+	middle = list->head->next;
+	while (1 < middle->count) {
+		Test_remove(list, model, &size, list->head->count);
+	}
+	ListNode* tail = list->tail;
+	Test_remove(list, model, &size, list->head->count);
+	TEST_CHECK(list->head->next == tail && list->tail == tail);
+	Test_check(list, model, size);
+
+	// Removing everything leaves no nodes
+	while (0 < size) {
+		Test_remove(list, model, &size, size / 2);
+	}
+	TEST_CHECK(NULL == list->head && NULL == list->tail && LinkedList_isEmpty(list));
+	Test_check(list, model, size);
+
+	// Random adds and removes, biased toward appends so the list grows through many nodes
+	unsigned int seed = 88172645u;
+	for (int step = 0; step < TEST_STEPS; step++) {
+		unsigned int op = Test_random(&seed) % 10;
+		if (6 > op && TEST_MAX_SIZE > size) {
+			int index = (2 > op) ? size : (int)(Test_random(&seed) % (unsigned int)(size + 1));
+			Test_add(list, model, &size, index, step + 1000);
+		} else if (0 < size) {
+			int index = (8 == op) ? size - 1 : (int)(Test_random(&seed) % (unsigned int)size);
+			Test_remove(list, model, &size, index);
+		}
+		if (0 == step % 499) {
+			Test_check(list, model, size);
+			TEST_CHECK(0 == size || 1 == LinkedList_contains(list, (void*)model[size / 2]));
+		}
+	}
+	Test_check(list, model, size);
+	TEST_CHECK(0 == LinkedList_contains(list, (void*)-1L));
+	LinkedList_delete(list);
+	return 0;
+}
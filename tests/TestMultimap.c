@@ -0,0 +1,159 @@
+// TestMultimap.c
+// Multimap trees keep one LinkedList group per key, through appends, removals, joins and refused unions,
+// and free each value exactly once.
+
+#include "Test.h"
+
+#define TEST_KEYS 200
+#define TEST_VALUES 40						// Values appended under each key, spanning several list nodes
+
+static int keys[TEST_KEYS];
+static int values[TEST_KEYS][TEST_VALUES];
+static int freed[TEST_KEYS][TEST_VALUES];
+
+void Test_freeValue(void* value) {
+	int index = (int*)value - &values[0][0];
+	freed[index / TEST_VALUES][index % TEST_VALUES]++;
+}
+
+RBTree* Test_createMultimap() {
+	RBTree* tree = RBTree_create(intCompare);
+	if (NULL == tree || 0 != RBTree_setMultimap(tree, 1)) {
+		return NULL;
+	}
+	RBTree_setDestructors(tree, NULL, Test_freeValue);
+	return tree;
+}
+
+int Test_checkGroup(RBTree* tree, int key, int count) {
+	// The group of key holds its first count values in append order
+	LinkedList* group = RBTree_searchGroup(tree, &keys[key]);
+	if (NULL == group || count != LinkedList_size(group)) {
+		return 0;
+	}
+	for (int i = 0; i < count; i++) {
+		if (&values[key][i] != LinkedList_get(group, i)) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main() {
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = i;
+	}
+
+	// Joining two multimap trees around a new key gives that key a group of its own
+	RBTree* left = Test_createMultimap();
+	RBTree* right = Test_createMultimap();
+	TEST_CHECK(NULL != left && NULL != right);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		if (TEST_KEYS / 2 == i) {
+			continue;
+		}
+		for (int j = 0; j < TEST_VALUES; j++) {
+			TEST_CHECK((j ? 2 : 0) == RBTree_append(i < TEST_KEYS / 2 ? left : right, &keys[i], &values[i][j]));
+		}
+	}
+	// A key already in either tree would give it a second group
+	RBTree* other = Test_createMultimap();
+	TEST_CHECK(0 == RBTree_append(other, &keys[TEST_KEYS - 1], &values[TEST_KEYS - 1][0]));
+	TEST_CHECK(1 == RBTree_join(left, &keys[TEST_KEYS / 2 - 1], &values[TEST_KEYS / 2][0], right));
+	TEST_CHECK(1 == RBTree_join(left, &keys[TEST_KEYS / 2 + 1], &values[TEST_KEYS / 2][0], right));
+	TEST_CHECK(0 == RBTree_join(left, &keys[TEST_KEYS / 2], &values[TEST_KEYS / 2][0], right));
+	TEST_CHECK(TEST_KEYS == Test_checkRedBlack(left, 0));
+	for (int i = 0; i < TEST_KEYS; i++) {
+		TEST_CHECK(Test_checkGroup(left, i, TEST_KEYS / 2 == i ? 1 : TEST_VALUES));
+	}
+	TEST_CHECK(2 == RBTree_append(left, &keys[TEST_KEYS / 2], &values[TEST_KEYS / 2][1]));
+	TEST_CHECK(Test_checkGroup(left, TEST_KEYS / 2, 2));
+
+	// A join with an empty tree on either side still wraps the value
+	RBTree* empty = Test_createMultimap();
+	TEST_CHECK(0 == RBTree_remove(other, &keys[TEST_KEYS - 1]));
+	TEST_CHECK(0 == RBTree_join(other, &keys[0], &values[0][0], empty));
+	TEST_CHECK(1 == Test_checkRedBlack(other, 0) && Test_checkGroup(other, 0, 1));
+	RBTree_setDestructors(other, NULL, NULL);
+	RBTree_delete(other);
+
+	// A union is refused, even through the Par_ path, and leaves both trees as they were
+	RBTree* shared = Test_createMultimap();
+	RBTree_setDestructors(shared, NULL, NULL);
+	TEST_CHECK(0 == RBTree_append(shared, &keys[0], &values[0][0]));
+	TEST_CHECK(1 == RBTree_union(left, shared));
+	TEST_CHECK(1 == Par_RBTree_union(left, shared, 2));
+	TEST_CHECK(TEST_KEYS == Test_checkRedBlack(left, 0) && 1 == Test_checkRedBlack(shared, 0));
+	TEST_CHECK(Test_checkGroup(left, 0, TEST_VALUES) && Test_checkGroup(shared, 0, 1));
+	RBTree_delete(shared);
+
+	// Deleting the joined tree frees every value it holds once
+	RBTree_delete(left);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		for (int j = 0; j < TEST_VALUES; j++) {
+			int expected = (TEST_KEYS / 2 == i) ? (j < 2) : 1;
+			if (TEST_KEYS - 1 == i && 0 == j) {
+				expected++;				// Also removed from other above
+			}
+			TEST_CHECK(expected == freed[i][j]);
+		}
+	}
+
+	// Appending starts a group with 0 and joins it with 2, insert appends the same way
+	RBTree* tree = Test_createMultimap();
+	memset(freed, 0, sizeof(freed));
+	TEST_CHECK(1 == RBTree_append(tree, &keys[0], NULL) && 1 == RBTree_append(NULL, &keys[0], &values[0][0]));
+	for (int j = 0; j < TEST_VALUES; j++) {
+		for (int i = 0; i < TEST_KEYS; i += 2) {
+			if (j % 2) {
+				TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &values[i][j]));
+			} else {
+				TEST_CHECK((j ? 2 : 0) == RBTree_append(tree, &keys[i], &values[i][j]));
+			}
+		}
+	}
+	TEST_CHECK(1 == RBTree_isMultimap(tree) && 1 == RBTree_setMultimap(tree, 0));
+	TEST_CHECK(TEST_KEYS / 2 == Test_checkRedBlack(tree, 0));
+	for (int i = 0; i < TEST_KEYS; i++) {
+		TEST_CHECK((i % 2) ? NULL == RBTree_searchGroup(tree, &keys[i]) : Test_checkGroup(tree, i, TEST_VALUES));
+	}
+	RBTree* plain = RBTree_create(intCompare);
+	TEST_CHECK(1 == RBTree_append(plain, &keys[0], &values[0][0]));
+	TEST_CHECK(0 == RBTree_insert(plain, &keys[0], &values[0][0]));
+	TEST_CHECK(NULL == RBTree_searchGroup(plain, &keys[0]) && 1 == RBTree_removeValue(plain, &keys[0], &values[0][0]));
+	RBTree_delete(plain);
+
+	// Removing one value keeps the rest of the group in order and frees just that value
+	TEST_CHECK(1 == RBTree_removeValue(tree, &keys[1], &values[1][0]));
+	TEST_CHECK(1 == RBTree_removeValue(tree, &keys[0], &values[2][0]));
+	TEST_CHECK(0 == RBTree_removeValue(tree, &keys[0], &values[0][TEST_VALUES / 2]));
+	TEST_CHECK(1 == RBTree_removeValue(tree, &keys[0], &values[0][TEST_VALUES / 2]));
+	TEST_CHECK(1 == freed[0][TEST_VALUES / 2]);
+	LinkedList* group = RBTree_searchGroup(tree, &keys[0]);
+	TEST_CHECK(NULL != group && TEST_VALUES - 1 == LinkedList_size(group));
+	for (int j = 0, index = 0; j < TEST_VALUES; j++) {
+		if (TEST_VALUES / 2 != j) {
+			TEST_CHECK(&values[0][j] == LinkedList_get(group, index++));
+		}
+	}
+
+	// Removing the last value of a group removes its key
+	for (int j = 0; j < TEST_VALUES; j++) {
+		TEST_CHECK(0 == RBTree_removeValue(tree, &keys[2], &values[2][TEST_VALUES - 1 - j]));
+		TEST_CHECK(TEST_KEYS / 2 - (TEST_VALUES - 1 == j) == RBTree_size(tree));
+	}
+	TEST_CHECK(NULL == RBTree_searchGroup(tree, &keys[2]) && TEST_KEYS / 2 - 1 == Test_checkRedBlack(tree, 0));
+
+	// Removing a key frees its whole group, and deleting the tree frees the rest
+	TEST_CHECK(0 == RBTree_remove(tree, &keys[4]));
+	for (int j = 0; j < TEST_VALUES; j++) {
+		TEST_CHECK(1 == freed[2][j] && 1 == freed[4][j] && 0 == freed[6][j]);
+	}
+	RBTree_delete(tree);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		for (int j = 0; j < TEST_VALUES; j++) {
+			TEST_CHECK(((i % 2) ? 0 : 1) == freed[i][j]);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+// TestOptimistic.c
+// Lock-free lookups racing Par_ writers return only values that were in the tree.
+// Run it under ThreadSanitizer with make test-thread.
+
+#include "Test.h"
+
+#define TEST_KEYS 20000
+#define TEST_READERS 3
+#define TEST_ROUNDS 3
+
+int keys[TEST_KEYS];
+RBTree* tree;
+atomic_int stop;
+
+void* Test_reader(void* arg) {
+	// Even keys stay in the tree throughout, odd keys come and go
+	unsigned int state = 1 + (unsigned int)(long)arg;
+	long lookups = 0;
+	while (!atomic_load(&stop)) {
+		int even = 2 * (int)(Test_random(&state) % (TEST_KEYS / 2));
+		int* value = Par_RBTree_searchOptimistic(tree, &keys[even]);
+		TEST_CHECK(NULL != value && even == *value);
+		value = Par_RBTree_searchOptimistic(tree, &keys[even + 1]);
+		TEST_CHECK(NULL == value || even + 1 == *value);
+		value = Par_RBTree_search(tree, &keys[even + 1]);
+		TEST_CHECK(NULL == value || even + 1 == *value);
+		lookups++;
+	}
+	return (void*)lookups;
+}
+
+int main() {
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = i;
+	}
+	for (int arena = 0; arena < 2; arena++) {
+		tree = arena ? RBTree_createWithArena(intCompare, 0) : RBTree_create(intCompare);
+		for (int i = 0; i < TEST_KEYS; i += 2) {
+			TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &keys[i]));
+		}
+		atomic_store(&stop, 0);
+		pthread_t readers[TEST_READERS];
+		for (long r = 0; r < TEST_READERS; r++) {
+			TEST_CHECK(0 == pthread_create(&readers[r], NULL, Test_reader, (void*)r));
+		}
+		// Inserts and removals rebalance the whole tree under the readers, and removed nodes get reused
+		for (int round = 0; round < TEST_ROUNDS; round++) {
+			for (int i = 1; i < TEST_KEYS; i += 2) {
+				TEST_CHECK(0 == Par_RBTree_insert(tree, &keys[i], &keys[i]));
+			}
+			for (int i = 1; i < TEST_KEYS; i += 2) {
+				TEST_CHECK(0 == Par_RBTree_remove(tree, &keys[i]));
+			}
+		}
+		atomic_store(&stop, 1);
+		long lookups = 0;
+		for (int r = 0; r < TEST_READERS; r++) {
+			void* result;
+			pthread_join(readers[r], &result);
+			lookups += (long)result;
+		}
+		TEST_CHECK(0 < lookups);
+		TEST_CHECK(TEST_KEYS / 2 == RBTree_size(tree));
+		RBTree_delete(tree);
+	}
+	return 0;
+}
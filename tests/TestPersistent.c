@@ -0,0 +1,105 @@
+// TestPersistent.c
+// Snapshots of a persistent tree keep their contents while the tree changes, and are freed on release.
+
+#include "Test.h"
+
+#define TEST_KEYS 1000
+#define TEST_STEPS 12000
+#define TEST_SNAPSHOTS 40
+
+typedef struct Test_Collector {
+	int* keys;								// Keys seen so far, in visiting order
+	int count;								// Keys seen so far
+} TestCollector;
+
+int Test_collect(void* key, void* value, void* context) {
+	TestCollector* collector = context;
+	TEST_CHECK(key == value);
+	collector->keys[collector->count++] = *(int*)key;
+	return 0;
+}
+
+int Test_checkNode(RBPersistentNode* node) {
+	// Returns the black height below node, checking colors and references
+	if (NULL == node) {
+		return 1;
+	}
+	TEST_CHECK(1 <= atomic_load(&node->refCount));
+	if (RED == node->color) {
+		TEST_CHECK(!RBPersistentNode_isRed(node->children[0]) && !RBPersistentNode_isRed(node->children[1]));
+	}
+	int leftHeight = Test_checkNode(node->children[0]);
+	TEST_CHECK(leftHeight == Test_checkNode(node->children[1]));
+	return leftHeight + (BLACK == node->color);
+}
+
+int main() {
+	static int slots[TEST_KEYS];
+	static int counts[TEST_KEYS];
+	static int expected[TEST_SNAPSHOTS][TEST_STEPS];
+	static int seen[TEST_STEPS];
+	int expectedCount[TEST_SNAPSHOTS];
+	RBSnapshot* snapshots[TEST_SNAPSHOTS];
+	for (int i = 0; i < TEST_KEYS; i++) {
+		slots[i] = i;
+	}
+	RBPersistentTree* tree = RBPersistentTree_create(intCompare);
+	TEST_CHECK(NULL != tree);
+	int size = 0;
+	int taken = 0;
+	unsigned int state = 23;
+	for (int step = 0; step < TEST_STEPS; step++) {
+		int key = (int)(Test_random(&state) % TEST_KEYS);
+		if (Test_random(&state) % 3) {
+			TEST_CHECK(0 == RBPersistentTree_insert(tree, &slots[key], &slots[key]));
+			counts[key]++;
+			size++;
+		} else {
+			TEST_CHECK((0 == counts[key]) == (1 == RBPersistentTree_remove(tree, &slots[key])));
+			if (0 < counts[key]) {
+				counts[key]--;
+				size--;
+			}
+		}
+		if (0 == step % (TEST_STEPS / TEST_SNAPSHOTS) && taken < TEST_SNAPSHOTS) {
+			// Record what the snapshot must keep showing from now on
+			snapshots[taken] = RBPersistentTree_snapshot(tree);
+			TEST_CHECK(NULL != snapshots[taken]);
+			expectedCount[taken] = 0;
+			for (int k = 0; k < TEST_KEYS; k++) {
+				for (int c = 0; c < counts[k]; c++) {
+					expected[taken][expectedCount[taken]++] = k;
+				}
+			}
+			TEST_CHECK(size == expectedCount[taken]);
+			taken++;
+		}
+		if (0 == step % 97) {
+			Test_checkNode(tree->root);
+		}
+	}
+
+	// Every snapshot still shows its own version; release half before the tree goes and half after
+	for (int i = 0; i < taken; i++) {
+		TestCollector collector = { seen, 0 };
+		TEST_CHECK(expectedCount[i] == RBSnapshot_getSize(snapshots[i]));
+		TEST_CHECK(0 == RBSnapshot_forEach(snapshots[i], Test_collect, &collector));
+		TEST_CHECK(expectedCount[i] == collector.count);
+		TEST_CHECK(0 == memcmp(seen, expected[i], (size_t)collector.count * sizeof(int)));
+		for (int k = 0; k < collector.count; k++) {
+			TEST_CHECK(&slots[seen[k]] == RBSnapshot_search(snapshots[i], &slots[seen[k]]));
+		}
+		Test_checkNode(snapshots[i]->root);
+		if (1 == i % 2) {
+			RBSnapshot_release(snapshots[i]);
+		}
+	}
+	RBPersistentTree_delete(tree);
+	for (int i = 0; i < taken; i += 2) {
+		TestCollector collector = { seen, 0 };
+		RBSnapshot_forEach(snapshots[i], Test_collect, &collector);
+		TEST_CHECK(expectedCount[i] == collector.count);
+		RBSnapshot_release(snapshots[i]);
+	}
+	return 0;
+}
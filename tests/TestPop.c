@@ -0,0 +1,61 @@
+// TestPop.c
+// RBTree_popMin and RBTree_popMax return the smallest and largest entries and leave a valid tree.
+
+#include "Test.h"
+
+#define TEST_KEYS 2000
+
+int main() {
+	static int keys[TEST_KEYS];
+	static int values[TEST_KEYS];
+	void* key = NULL;
+	void* value = NULL;
+	RBTree* tree = RBTree_create(intCompare);
+	// Nothing to pop, and the outputs are left alone
+	TEST_CHECK(1 == RBTree_popMin(tree, &key, &value));
+	TEST_CHECK(1 == RBTree_popMax(tree, &key, &value));
+	TEST_CHECK(NULL == key && NULL == value);
+	TEST_CHECK(1 == RBTree_popMin(NULL, &key, &value));
+
+	// A single node is both the minimum and the maximum
+	int only = 42;
+	for (int side = 0; side < 2; side++) {
+		TEST_CHECK(0 == RBTree_insert(tree, &only, &values[0]));
+		TEST_CHECK(0 == (side ? RBTree_popMax(tree, &key, &value) : RBTree_popMin(tree, &key, &value)));
+		TEST_CHECK(&only == key && &values[0] == value);
+		TEST_CHECK(NULL == RBTree_getRoot(tree) && 0 == RBTree_size(tree));
+	}
+
+	// Keys 0, 0, 1, 1, ... inserted out of order, each with its own value
+	for (int i = 0; i < TEST_KEYS; i++) {
+		int at = (int)(((long)i * 7919) % TEST_KEYS);
+		keys[at] = at / 2;
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[at], &values[at]));
+	}
+	static int popped[TEST_KEYS];
+	int lo = 0;
+	int hi = TEST_KEYS - 1;
+	unsigned int state = 3;
+	while (lo <= hi) {
+		int fromMax = (int)(Test_random(&state) % 2);
+		int expected = fromMax ? hi-- : lo++;
+		if (0 == Test_random(&state) % 8) {
+			// The outputs are optional
+			TEST_CHECK(0 == (fromMax ? RBTree_popMax(tree, NULL, NULL) : RBTree_popMin(tree, NULL, NULL)));
+		} else {
+			TEST_CHECK(0 == (fromMax ? RBTree_popMax(tree, &key, &value) : RBTree_popMin(tree, &key, &value)));
+			// Equal keys come in pairs, so the value names which of the two entries was taken
+			TEST_CHECK(expected / 2 == *(int*)key);
+			int index = (int)((int*)value - values);
+			TEST_CHECK(0 <= index && TEST_KEYS > index && &keys[index] == key && !popped[index]);
+			popped[index] = 1;
+		}
+		TEST_CHECK(hi - lo + 1 == RBTree_size(tree));
+		if (0 == lo % 100) {
+			Test_checkRedBlack(tree, 0);
+		}
+	}
+	TEST_CHECK(NULL == RBTree_getRoot(tree) && 1 == RBTree_popMax(tree, NULL, NULL));
+	RBTree_delete(tree);
+	return 0;
+}
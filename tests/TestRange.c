@@ -0,0 +1,62 @@
+// TestRange.c
+// Range iterators yield exactly the keys in [lo, hi), for bounds on, between and outside the keys.
+
+#include "Test.h"
+
+#define TEST_KEYS 60
+#define TEST_RANGE 100
+
+void Test_checkRange(RBTreeIterator* iter, int* reference, int n, int* lo, int* hi) {
+	// NULL bounds leave that side open
+	for (int i = 0; i < n; i++) {
+		if ((NULL != lo && reference[i] < *lo) || (NULL != hi && reference[i] >= *hi)) {
+			continue;
+		}
+		TEST_CHECK(RBTreeIterator_hasNext(iter));
+		RBTreeIterator_getNext(iter);
+		TEST_CHECK(reference[i] == *(int*)RBTreeIterator_getKey(iter));
+	}
+	TEST_CHECK(!RBTreeIterator_hasNext(iter));
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	static int reference[TEST_KEYS];
+	RBTree* tree = RBTree_create(intCompare);
+	RBTreeIterator iter;
+	// An empty tree has nothing in any range
+	int zero = 0;
+	RBTreeIterator_initRange(&iter, tree, &zero, NULL);
+	TEST_CHECK(!RBTreeIterator_hasNext(&iter));
+	RBTreeIterator_initRange(&iter, tree, NULL, NULL);
+	TEST_CHECK(!RBTreeIterator_hasNext(&iter));
+
+	// Even keys from 10 on, with the last ten repeating earlier ones
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = (i < TEST_KEYS - 10) ? 10 + 2 * i : 10 + 4 * (i - TEST_KEYS + 10);
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &keys[i]));
+		int at = i;
+		while (0 < at && reference[at - 1] > keys[i]) {
+			reference[at] = reference[at - 1];
+			at--;
+		}
+		reference[at] = keys[i];
+	}
+	// Bounds run from below the smallest key to above the largest, hitting keys and the gaps between them
+	for (int lo = -2; lo <= TEST_RANGE + 20; lo++) {
+		for (int hi = -2; hi <= TEST_RANGE + 20; hi++) {
+			RBTreeIterator_initRange(&iter, tree, &lo, &hi);
+			Test_checkRange(&iter, reference, TEST_KEYS, &lo, &hi);
+		}
+		RBTreeIterator_initRange(&iter, tree, &lo, NULL);
+		Test_checkRange(&iter, reference, TEST_KEYS, &lo, NULL);
+		RBTreeIterator* heapIter = RBTreeIterator_createRange(tree, NULL, &lo);
+		TEST_CHECK(NULL != heapIter);
+		Test_checkRange(heapIter, reference, TEST_KEYS, NULL, &lo);
+		RBTreeIterator_delete(heapIter);
+	}
+	RBTreeIterator_initRange(&iter, tree, NULL, NULL);
+	Test_checkRange(&iter, reference, TEST_KEYS, NULL, NULL);
+	RBTree_delete(tree);
+	return 0;
+}
@@ -0,0 +1,78 @@
+// TestRank.c
+// RBTree_rank and RBTree_select against a sorted array, with duplicate keys, removals and out-of-range indexes.
+
+#include "Test.h"
+
+#define TEST_KEYS 3000
+#define TEST_RANGE 500
+
+void Test_checkRanks(RBTree* tree, int* reference, int n) {
+	// Rank counts the keys strictly before, so for duplicates it names the first of them
+	int below = 0;
+	for (int key = -1; key <= TEST_RANGE; key++) {
+		while (below < n && reference[below] < key) {
+			below++;
+		}
+		TEST_CHECK(below == RBTree_rank(tree, &key));
+	}
+	for (int i = 0; i < n; i++) {
+		int* key = RBTree_select(tree, i);
+		TEST_CHECK(NULL != key && reference[i] == *key);
+	}
+	TEST_CHECK(NULL == RBTree_select(tree, -1));
+	TEST_CHECK(NULL == RBTree_select(tree, n));
+	TEST_CHECK(NULL == RBTree_select(tree, n + 100));
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	unsigned int state = 11;
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = (int)(Test_random(&state) % TEST_RANGE);
+	}
+
+	// Without subtree sizes neither call can answer
+	RBTree* plain = RBTree_create(intCompare);
+	RBTree_insert(plain, &keys[0], &keys[0]);
+	TEST_CHECK(!RBTree_isAugmented(plain));
+	TEST_CHECK(-1 == RBTree_rank(plain, &keys[0]));
+	TEST_CHECK(NULL == RBTree_select(plain, 0));
+	// and the mode cannot change once the tree has nodes
+	TEST_CHECK(1 == RBTree_setAugmented(plain, 1));
+	RBTree_delete(plain);
+
+	RBTree* tree = RBTree_create(intCompare);
+#ifdef RBTREE_COMPACT_NODES
+	TEST_CHECK(1 == RBTree_setAugmented(tree, 1));
+	RBTree_delete(tree);
+	return 0;
+#else
+	static int reference[TEST_KEYS];
+	TEST_CHECK(0 == RBTree_setAugmented(tree, 1));
+	Test_checkRanks(tree, reference, 0);
+	int n = 0;
+	for (int i = 0; i < TEST_KEYS; i++) {
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &keys[i]));
+		int at = n++;
+		while (0 < at && reference[at - 1] > keys[i]) {
+			reference[at] = reference[at - 1];
+			at--;
+		}
+		reference[at] = keys[i];
+	}
+	Test_checkRanks(tree, reference, n);
+	// Remove every other key in input order, one copy at a time
+	for (int i = 0; i < TEST_KEYS; i += 2) {
+		TEST_CHECK(0 == RBTree_remove(tree, &keys[i]));
+		int at = 0;
+		while (reference[at] != keys[i]) {
+			at++;
+		}
+		memmove(reference + at, reference + at + 1, (size_t)(n - at - 1) * sizeof(int));
+		n--;
+	}
+	Test_checkRanks(tree, reference, n);
+	RBTree_delete(tree);
+	return 0;
+#endif
+}
@@ -0,0 +1,84 @@
+// TestRemove.c
+// Random inserts and removals checked against a sorted array and the red-black invariants.
+
+#include "Test.h"
+
+#define TEST_KEYS 3000
+#define TEST_STEPS 40000
+
+void Test_checkTree(RBTree* tree, int* reference, int n) {
+	TEST_CHECK(n == Test_checkRedBlack(tree, RBTree_isAugmented(tree)));
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	for (int i = 0; i < n; i++) {
+		TEST_CHECK(RBTreeIterator_hasNext(&iter));
+		RBTreeIterator_getNext(&iter);
+		TEST_CHECK(reference[i] == *(int*)RBTreeIterator_getKey(&iter));
+	}
+	TEST_CHECK(!RBTreeIterator_hasNext(&iter));
+}
+
+int main() {
+	// Keys 0..TEST_KEYS-1 each have a slot, small enough that duplicates are common
+	static int slots[TEST_KEYS];
+	static int counts[TEST_KEYS];
+	static int reference[TEST_STEPS];
+	for (int i = 0; i < TEST_KEYS; i++) {
+		slots[i] = i;
+	}
+	for (int mode = 0; mode < 3; mode++) {
+		RBTree* tree = (2 == mode) ? RBTree_createWithArena(intCompare, 128) : RBTree_create(intCompare);
+#ifndef RBTREE_COMPACT_NODES
+		TEST_CHECK(0 == RBTree_setAugmented(tree, 1 == mode));
+#endif
+		memset(counts, 0, sizeof(counts));
+		int n = 0;
+		unsigned int state = 7 + mode;
+		for (int step = 0; step < TEST_STEPS; step++) {
+			int key = (int)(Test_random(&state) % TEST_KEYS);
+			if (Test_random(&state) % 5 < 3) {
+				TEST_CHECK(0 == RBTree_insert(tree, &slots[key], &slots[key]));
+				int at = n;
+				while (0 < at && reference[at - 1] > key) {
+					reference[at] = reference[at - 1];
+					at--;
+				}
+				reference[at] = key;
+				counts[key]++;
+				n++;
+			} else {
+				TEST_CHECK((0 == counts[key]) == (1 == RBTree_remove(tree, &slots[key])));
+				if (0 < counts[key]) {
+					int at = 0;
+					while (reference[at] != key) {
+						at++;
+					}
+					memmove(reference + at, reference + at + 1, (size_t)(n - at - 1) * sizeof(int));
+					counts[key]--;
+					n--;
+				}
+			}
+			if (0 == step % 500) {
+				Test_checkTree(tree, reference, n);
+			}
+		}
+		Test_checkTree(tree, reference, n);
+		// Drain it completely, checking along the way
+		while (0 < n) {
+			int key = reference[Test_random(&state) % n];
+			TEST_CHECK(0 == RBTree_remove(tree, &slots[key]));
+			int at = 0;
+			while (reference[at] != key) {
+				at++;
+			}
+			memmove(reference + at, reference + at + 1, (size_t)(n - at - 1) * sizeof(int));
+			n--;
+			if (0 == n % 250) {
+				Test_checkTree(tree, reference, n);
+			}
+		}
+		TEST_CHECK(NULL == RBTree_getRoot(tree));
+		RBTree_delete(tree);
+	}
+	return 0;
+}
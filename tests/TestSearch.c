@@ -0,0 +1,37 @@
+// TestSearch.c
+// Single and batched lookups agree for a comparator that returns any magnitude.
+
+#include "Test.h"
+
+#define TEST_KEYS 2000
+
+int wideCompare(void* a, void* b) {
+	// Positive when a < b, as Comparator requires, but scaled well past 1
+	return (*(int*)b - *(int*)a) * 1000;
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	void* keyPtrs[2 * TEST_KEYS];
+	void* values[2 * TEST_KEYS];
+	RBTree* tree = RBTree_create(wideCompare);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = 2 * ((i * 577) % TEST_KEYS);
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &keys[i]));
+	}
+	// Even probes are present, odd ones fall between keys
+	static int probes[2 * TEST_KEYS];
+	for (int i = 0; i < 2 * TEST_KEYS; i++) {
+		probes[i] = i;
+		keyPtrs[i] = &probes[i];
+	}
+	TEST_CHECK(0 == RBTree_searchBatch(tree, keyPtrs, values, 2 * TEST_KEYS));
+	for (int i = 0; i < 2 * TEST_KEYS; i++) {
+		void* value = RBTree_search(tree, &probes[i]);
+		TEST_CHECK(value == values[i]);
+		TEST_CHECK((0 == i % 2) == (NULL != value));
+		TEST_CHECK(NULL == value || i == *(int*)value);
+	}
+	RBTree_delete(tree);
+	return 0;
+}
@@ -0,0 +1,90 @@
+// TestSharded.c
+// Hashed and ranged sharded trees route each key to one shard and iterate all keys in order.
+
+#include "Test.h"
+#include <limits.h>
+
+#define TEST_KEYS 2000
+#define TEST_SHARDS 4
+
+unsigned long Test_hash(void* key) {
+	return (unsigned long)*(int*)key;
+}
+
+void Test_checkTree(RBShardedTree* tree, int* keys, int n) {
+	// Every key is found in its own shard only, and the iterator yields keys[0..n) in order
+	for (int i = 0; i < n; i++) {
+		int shard = RBShardedTree_getShardIndex(tree, &keys[i]);
+		TEST_CHECK(0 <= shard && TEST_SHARDS > shard);
+		TEST_CHECK(&keys[i] == RBShardedTree_search(tree, &keys[i]));
+		for (int j = 0; j < TEST_SHARDS; j++) {
+			TEST_CHECK((j == shard) == (NULL != RBTree_search(RBShardedTree_getShard(tree, j), &keys[i])));
+		}
+	}
+	RBShardedTreeIterator* iter = RBShardedTreeIterator_create(tree);
+	TEST_CHECK(NULL != iter);
+	for (int i = 0; i < n; i++) {
+		TEST_CHECK(RBShardedTreeIterator_hasNext(iter));
+		RBShardedTreeIterator_getNext(iter);
+		TEST_CHECK(keys[i] == *(int*)RBShardedTreeIterator_getKey(iter));
+		TEST_CHECK(&keys[i] == RBShardedTreeIterator_getValue(iter));
+	}
+	TEST_CHECK(!RBShardedTreeIterator_hasNext(iter));
+	RBShardedTreeIterator_delete(iter);
+}
+
+void Test_fill(RBShardedTree* tree, int* keys, int n) {
+	// Inserts in a scrambled order so no shard fills in key order
+	for (int i = 0; i < n; i++) {
+		int at = (int)(((long)i * 7919) % n);
+		TEST_CHECK(0 == RBShardedTree_insert(tree, &keys[at], &keys[at]));
+	}
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = i - TEST_KEYS / 4;
+	}
+
+	RBShardedTree* hashed = RBShardedTree_createHashed(intCompare, Test_hash, TEST_SHARDS);
+	TEST_CHECK(NULL != hashed);
+	Test_fill(hashed, keys, TEST_KEYS);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		TEST_CHECK((int)((unsigned long)keys[i] % TEST_SHARDS) == RBShardedTree_getShardIndex(hashed, &keys[i]));
+	}
+	Test_checkTree(hashed, keys, TEST_KEYS);
+	// Upserts land in the same shard as the key they replace
+	static int replacement = 0;
+	TEST_CHECK(2 == RBShardedTree_upsert(hashed, &keys[7], &replacement, NULL));
+	TEST_CHECK(&replacement == RBShardedTree_search(hashed, &keys[7]));
+	RBShardedTree_delete(hashed);
+
+	// Shard i holds [splitters[i - 1], splitters[i]), and the middle shards stay empty
+	int bounds[TEST_SHARDS - 1] = {0, 0, 500};
+	void* splitters[TEST_SHARDS - 1] = {&bounds[0], &bounds[1], &bounds[2]};
+	RBShardedTree* ranged = RBShardedTree_createRanged(intCompare, splitters, TEST_SHARDS);
+	TEST_CHECK(NULL != ranged);
+	Test_fill(ranged, keys, TEST_KEYS);
+	int probes[] = {INT_MIN, -1, 0, 1, 499, 500, INT_MAX};
+	int expected[] = {0, 0, 2, 2, 2, 3, 3};
+	for (size_t i = 0; i < sizeof(probes) / sizeof(probes[0]); i++) {
+		TEST_CHECK(expected[i] == RBShardedTree_getShardIndex(ranged, &probes[i]));
+	}
+	TEST_CHECK(0 == RBTree_size(RBShardedTree_getShard(ranged, 1)));
+	Test_checkTree(ranged, keys, TEST_KEYS);
+	RBShardedTree_delete(ranged);
+
+	// An empty sharded tree iterates nothing
+	ranged = RBShardedTree_createRanged(intCompare, splitters, TEST_SHARDS);
+	Test_checkTree(ranged, keys, 0);
+	RBShardedTree_delete(ranged);
+
+	// Descending splitters, a missing hash and no shards are rejected
+	bounds[1] = -5;
+	TEST_CHECK(NULL == RBShardedTree_createRanged(intCompare, splitters, TEST_SHARDS));
+	TEST_CHECK(NULL == RBShardedTree_createHashed(intCompare, NULL, TEST_SHARDS));
+	TEST_CHECK(NULL == RBShardedTree_createHashed(intCompare, Test_hash, 0));
+	TEST_CHECK(NULL == RBShardedTree_getShard(NULL, 0));
+	return 0;
+}
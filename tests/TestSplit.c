@@ -0,0 +1,79 @@
+// TestSplit.c
+// Split, join and set operations keep RBTree_size exact, and filters accept any other tree.
+
+#include "Test.h"
+
+#define TEST_KEYS 3000
+
+int Test_count(RBTree* tree) {
+	int count = 0;
+	RBTreeIterator iter;
+	RBTreeIterator_init(&iter, tree);
+	while (RBTreeIterator_hasNext(&iter)) {
+		RBTreeIterator_getNext(&iter);
+		count++;
+	}
+	return count;
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = i / 2;
+	}
+	unsigned int state = 5;
+#ifdef RBTREE_COMPACT_NODES
+	int modes = 1;
+#else
+	int modes = 2;
+#endif
+	for (int augmented = 0; augmented < modes; augmented++) {
+		for (int round = 0; round < 40; round++) {
+			RBTree* tree = RBTree_create(intCompare);
+			TEST_CHECK(0 == RBTree_setAugmented(tree, augmented));
+			int n = (int)(Test_random(&state) % TEST_KEYS);
+			for (int i = 0; i < n; i++) {
+				RBTree_insert(tree, &keys[i], &keys[i]);
+			}
+			// Split points cover both ends and the middle of the key range
+			int splitKey = (int)(Test_random(&state) % (TEST_KEYS / 2 + 2)) - 1;
+			RBTree* upper = RBTree_split(tree, &splitKey);
+			TEST_CHECK(NULL != upper);
+			TEST_CHECK(Test_count(tree) == RBTree_size(tree));
+			TEST_CHECK(Test_count(upper) == RBTree_size(upper));
+			TEST_CHECK(n == RBTree_size(tree) + RBTree_size(upper));
+
+			RBTree* other = RBTree_create(intCompare);
+			TEST_CHECK(0 == RBTree_setAugmented(other, augmented));
+			for (int i = 0; i < n; i += 3) {
+				RBTree_insert(other, &keys[i], &keys[i]);
+			}
+			TEST_CHECK(0 == RBTree_difference(upper, other));
+			TEST_CHECK(Test_count(upper) == RBTree_size(upper));
+			TEST_CHECK(0 == RBTree_union(tree, upper));
+			TEST_CHECK(Test_count(tree) == RBTree_size(tree));
+			TEST_CHECK(0 == RBTree_intersect(tree, other));
+			TEST_CHECK(Test_count(tree) == RBTree_size(tree));
+			RBTree_delete(other);
+			RBTree_delete(tree);
+		}
+	}
+	// Filters only search other, so it may allocate and augment differently from tree
+	RBTree* arenaTree = RBTree_createWithArena(intCompare, 0);
+	RBTree* mallocTree = RBTree_create(intCompare);
+	for (int i = 0; i < TEST_KEYS; i++) {
+		RBTree_insert(arenaTree, &keys[i], &keys[i]);
+		if (0 == i % 4) {
+			RBTree_insert(mallocTree, &keys[i], &keys[i]);
+		}
+	}
+	TEST_CHECK(1 == RBTree_union(arenaTree, mallocTree));
+	TEST_CHECK(0 == Par_RBTree_difference(mallocTree, arenaTree, 2));
+	TEST_CHECK(0 == RBTree_size(mallocTree));
+	TEST_CHECK(0 == Par_RBTree_intersect(arenaTree, mallocTree, 2));
+	TEST_CHECK(0 == RBTree_size(arenaTree));
+	TEST_CHECK(1 == RBTree_intersect(arenaTree, arenaTree));
+	RBTree_delete(mallocTree);
+	RBTree_delete(arenaTree);
+	return 0;
+}
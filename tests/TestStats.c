@@ -0,0 +1,112 @@
+// TestStats.c
+// RBTree_stats reports the counters of a known sequence of operations and the shape of the tree.
+// Built as TestStats-stats with -DRBTREE_STATS; without it every counter must stay zero.
+
+#include "Test.h"
+
+#define TEST_KEYS 1000
+
+int Test_checkNoCounters(RBTreeStats* stats) {
+	RBTreeCounters zero;
+	memset(&zero, 0, sizeof(RBTreeCounters));
+	return 0 == memcmp(&stats->counters, &zero, sizeof(RBTreeCounters));
+}
+
+int main() {
+	static int keys[TEST_KEYS];
+	RBTreeStats stats;
+	for (int i = 0; i < TEST_KEYS; i++) {
+		keys[i] = i;
+	}
+	TEST_CHECK(1 == RBTree_stats(NULL, &stats));
+
+	// An empty tree has one empty subtree, reached through no black nodes
+	RBTree* tree = RBTree_create(intCompare);
+	TEST_CHECK(0 == RBTree_stats(tree, &stats));
+	TEST_CHECK(Test_checkNoCounters(&stats));
+	TEST_CHECK(0 == stats.height && 0 == stats.depths[0] && 1 == stats.blackHeights[0]);
+
+	// 1, 2, 3 in order: the root is recolored black, then 3 recolors 2 and 1 and rotates 1 left
+	for (int i = 1; i <= 3; i++) {
+		TEST_CHECK(0 == RBTree_insert(tree, &keys[i], &keys[i]));
+	}
+	TEST_CHECK(0 == RBTree_stats(tree, &stats));
+	TEST_CHECK(2 == stats.height && 1 == stats.depths[0] && 2 == stats.depths[1] && 0 == stats.depths[2]);
+	TEST_CHECK(4 == stats.blackHeights[1] && 0 == stats.blackHeights[0] && 0 == stats.blackHeights[2]);
+#ifdef RBTREE_STATS
+	TEST_CHECK(1 == stats.counters.leftRotations && 0 == stats.counters.rightRotations);
+	TEST_CHECK(3 == stats.counters.recolors);
+	TEST_CHECK(3 == stats.counters.comparisons);
+	TEST_CHECK(1 == stats.counters.timedComparisons);
+	TEST_CHECK(0 == stats.counters.searches && 0 == stats.counters.searchVisits);
+#else
+	TEST_CHECK(Test_checkNoCounters(&stats));
+#endif
+
+	// Searches for the root, a leaf and a missing key visit 1, 2 and 2 nodes
+	RBTree_resetStats(tree);
+	TEST_CHECK(0 == RBTree_stats(tree, &stats));
+	TEST_CHECK(Test_checkNoCounters(&stats));
+	TEST_CHECK(&keys[2] == RBTree_search(tree, &keys[2]));
+	TEST_CHECK(&keys[3] == RBTree_search(tree, &keys[3]));
+	TEST_CHECK(NULL == RBTree_search(tree, &keys[4]));
+	TEST_CHECK(0 == RBTree_stats(tree, &stats));
+#ifdef RBTREE_STATS
+	TEST_CHECK(3 == stats.counters.searches && 5 == stats.counters.searchVisits);
+	TEST_CHECK(0 == stats.counters.leftRotations && 0 == stats.counters.rightRotations);
+	TEST_CHECK(0 == stats.counters.recolors);
+#else
+	TEST_CHECK(Test_checkNoCounters(&stats));
+#endif
+	RBTree_delete(tree);
+
+	// A join of a large tree with a single key rebalances, and the scratch fixups count on the tree
+	RBTree* left = RBTree_create(intCompare);
+	RBTree* right = RBTree_create(intCompare);
+	for (int i = 0; i < TEST_KEYS - 2; i++) {
+		TEST_CHECK(0 == RBTree_insert(left, &keys[i], &keys[i]));
+	}
+	TEST_CHECK(0 == RBTree_insert(right, &keys[TEST_KEYS - 1], &keys[TEST_KEYS - 1]));
+	RBTree_resetStats(left);
+	TEST_CHECK(0 == RBTree_join(left, &keys[TEST_KEYS - 2], &keys[TEST_KEYS - 2], right));
+	TEST_CHECK(TEST_KEYS == Test_checkRedBlack(left, 0));
+	TEST_CHECK(0 == RBTree_stats(left, &stats));
+	long total = 0;
+	for (int depth = 0; depth < RBTREE_STATS_DEPTHS; depth++) {
+		total += stats.depths[depth];
+	}
+	TEST_CHECK(TEST_KEYS == total && 0 == stats.depths[stats.height]);
+#ifdef RBTREE_STATS
+	TEST_CHECK(0 < stats.counters.recolors);
+	TEST_CHECK(0 < stats.counters.leftRotations + stats.counters.rightRotations);
+#else
+	TEST_CHECK(Test_checkNoCounters(&stats));
+#endif
+
+	// Splitting it back apart joins the pieces along the way, recoloring them
+	RBTree_resetStats(left);
+	right = RBTree_split(left, &keys[TEST_KEYS / 3]);
+	TEST_CHECK(NULL != right);
+	TEST_CHECK(TEST_KEYS / 3 == Test_checkRedBlack(left, 0));
+	TEST_CHECK(TEST_KEYS - TEST_KEYS / 3 == Test_checkRedBlack(right, 0));
+	TEST_CHECK(0 == RBTree_stats(left, &stats));
+#ifdef RBTREE_STATS
+	TEST_CHECK(0 < stats.counters.recolors);
+#else
+	TEST_CHECK(Test_checkNoCounters(&stats));
+#endif
+
+	// A union rebuilds through joins as well
+	RBTree_resetStats(left);
+	TEST_CHECK(0 == RBTree_union(left, right));
+	TEST_CHECK(TEST_KEYS == Test_checkRedBlack(left, 0));
+	TEST_CHECK(0 == RBTree_stats(left, &stats));
+#ifdef RBTREE_STATS
+	TEST_CHECK(0 < stats.counters.recolors);
+#else
+	TEST_CHECK(Test_checkNoCounters(&stats));
+#endif
+	RBTree_delete(left);
+
+	return 0;
+}
@@ -0,0 +1,74 @@
+// TestUpsert.c
+// Upsert inserts absent keys, combines into present ones without growing the tree, and calls combine only then.
+
+#include "Test.h"
+
+#define TEST_RANGE 500
+#define TEST_STEPS 5000
+
+static int Test_combines = 0;
+static void* Test_lastExisting = NULL;
+
+void* Test_sum(void* existing, void* value) {
+	// Adds the new count into the existing one, which the test owns
+	Test_combines++;
+	Test_lastExisting = existing;
+	*(int*)existing += *(int*)value;
+	return existing;
+}
+
+int main() {
+	static int keys[TEST_RANGE];
+	static int totals[TEST_RANGE];
+	static int expected[TEST_RANGE];
+	static int present[TEST_RANGE];
+	static int one = 1;
+	for (int i = 0; i < TEST_RANGE; i++) {
+		keys[i] = i;
+	}
+	for (int parallel = 0; parallel < 2; parallel++) {
+		RBTree* tree = RBTree_create(intCompare);
+		memset(totals, 0, sizeof(totals));
+		memset(expected, 0, sizeof(expected));
+		memset(present, 0, sizeof(present));
+		int size = 0;
+		unsigned int state = 21;
+		for (int step = 0; step < TEST_STEPS; step++) {
+			int key = (int)(Test_random(&state) % TEST_RANGE);
+			int combines = Test_combines;
+			// A new key brings its own total, which later upserts add to
+			totals[key] = present[key] ? totals[key] : 1;
+			void* value = present[key] ? (void*)&one : (void*)&totals[key];
+			int result = parallel ? Par_RBTree_upsert(tree, &keys[key], value, Test_sum) : RBTree_upsert(tree, &keys[key], value, Test_sum);
+			if (present[key]) {
+				TEST_CHECK(2 == result);
+				TEST_CHECK(combines + 1 == Test_combines && &totals[key] == Test_lastExisting);
+			} else {
+				TEST_CHECK(0 == result);
+				TEST_CHECK(combines == Test_combines);
+				present[key] = 1;
+				size++;
+			}
+			expected[key]++;
+			TEST_CHECK(size == RBTree_size(tree));
+		}
+		for (int key = 0; key < TEST_RANGE; key++) {
+			int* total = RBTree_search(tree, &keys[key]);
+			TEST_CHECK(present[key] == (NULL != total));
+			TEST_CHECK(NULL == total || expected[key] == *total);
+		}
+		Test_checkRedBlack(tree, 0);
+		// Without a combiner the new value replaces the old one
+		int replacement = -1;
+		TEST_CHECK(present[0] && 2 == RBTree_upsert(tree, &keys[0], &replacement, NULL));
+		TEST_CHECK(&replacement == RBTree_search(tree, &keys[0]));
+		RBTree_delete(tree);
+	}
+	// Multimaps keep every value, so they have nothing to upsert into
+	RBTree* multimap = RBTree_create(intCompare);
+	TEST_CHECK(0 == RBTree_setMultimap(multimap, 1));
+	TEST_CHECK(1 == RBTree_upsert(multimap, &keys[0], &one, Test_sum));
+	TEST_CHECK(1 == RBTree_upsert(NULL, &keys[0], &one, Test_sum));
+	RBTree_delete(multimap);
+	return 0;
+}